@@ -45,6 +45,7 @@ protection within the United States.
 int FindMarker(FILE* infile, const char* marker);
 int ReadHex(FILE* infile, unsigned char* A, int Length, char* str);
 void fprintBstr(FILE* fp, char* S, unsigned char* A, unsigned long long L);
+int CheckSignBatch(unsigned char* seed, const unsigned char* m, unsigned long long mlen);
 
 char AlgName[] = CRYPTO_ALGNAME;
 
@@ -178,6 +179,11 @@ int main()
             return KAT_CRYPTO_FAILURE;
         }
 
+        if (count == 0 && CheckSignBatch(seed, m, mlen) != KAT_SUCCESS) {
+            printf("hypericum_sign_batch differs from single signatures\n");
+            return KAT_CRYPTO_FAILURE;
+        }
+
         free(m);
         free(m1);
         free(sm);
@@ -190,6 +196,47 @@ int main()
     return KAT_SUCCESS;
 }
 
+//
+// SIGN A MESSAGE TWICE ONE BY ONE AND AS A BATCH FROM THE SAME SEED, THE
+// SIGNATURES MUST BE THE SAME
+//
+int CheckSignBatch(unsigned char* seed, const unsigned char* m, unsigned long long mlen)
+{
+    unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+    const unsigned char* msgs[2] = { m, m };
+    size_t mlens[2] = { (size_t)mlen, (size_t)mlen };
+    unsigned char* single = (unsigned char*)calloc(2 * CRYPTO_BYTES, sizeof(unsigned char));
+    unsigned char* batch = (unsigned char*)calloc(2 * CRYPTO_BYTES, sizeof(unsigned char));
+    unsigned char* sigs[2] = { batch, batch + CRYPTO_BYTES };
+    int ret_val = KAT_CRYPTO_FAILURE;
+
+    if (single == NULL || batch == NULL) {
+        goto cleanup;
+    }
+
+    randombytes_init(seed);
+    if (crypto_sign_keypair(pk, sk) != 0 ||
+        hypericum_sign_detached(single, m, mlen, sk) != 0 ||
+        hypericum_sign_detached(single + CRYPTO_BYTES, m, mlen, sk) != 0) {
+        goto cleanup;
+    }
+
+    randombytes_init(seed);
+    if (crypto_sign_keypair(pk, sk) != 0 ||
+        hypericum_sign_batch(sk, msgs, mlens, 2, sigs) != 0) {
+        goto cleanup;
+    }
+
+    if (memcmp(single, batch, 2 * CRYPTO_BYTES) == 0) {
+        ret_val = KAT_SUCCESS;
+    }
+
+cleanup:
+    free(single);
+    free(batch);
+    return ret_val;
+}
+
 //
 // ALLOW TO READ HEXADECIMAL ENTRY (KEYS, DATA, TEXT, etc.)
 //
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 #define HYPERICUM_ADRS_SIZE_BYTES 28
 
@@ -42,49 +43,309 @@ enum address_type {
     address_keygen_fors = 7
 };
 
-typedef struct _adrs hypericum_adrs_t;
+// Offsets of the words in the big-endian address image
+#define HYP_ADRS_LAYER_OFFSET 0
+#define HYP_ADRS_TREE_OFFSET 4
+#define HYP_ADRS_TYPE_OFFSET 12
+#define HYP_ADRS_KEYPAIR_OFFSET 16
+#define HYP_ADRS_DATA_OFFSET 20
 
-hypericum_adrs_t* hypericum_adrs_create();
-void hypericum_adrs_destroy(hypericum_adrs_t* adrs);
+/**
+ * Hypericum address, a value type to be kept on the stack.
+ *
+ * `bytes` is the serialized address and is kept current by every setter, so
+ * that hash functions take it as is. The two data words (chain and hash
+ * address, tree height and index, ...) are also kept as numbers: they
+ * survive type changes, while the image shows only what the current type
+ * serializes.
+ */
+typedef struct hypericum_adrs_st
+{
+    uint8_t bytes[HYPERICUM_ADRS_SIZE_BYTES];
+    enum address_type type;
+    uint32_t data[2];
+} hypericum_adrs_t;
 
-void hypericum_adrs_set_wots_hash_hash_address(
-    hypericum_adrs_t* adrs, uint32_t value);
+static inline void hypericum_adrs_store32(uint8_t* bytes, uint32_t value)
+{
+    // big endian
+    bytes[0] = value >> 8 * 3 & 0xFF;
+    bytes[1] = value >> 8 * 2 & 0xFF;
+    bytes[2] = value >> 8 & 0xFF;
+    bytes[3] = value & 0xFF;
+}
 
-void hypericum_adrs_set_wots_hash_chain_address(
-    hypericum_adrs_t* adrs, uint32_t value);
+// Number of data words the address type serializes, the rest are zero.
+static inline uint32_t hypericum_adrs_data_words(enum address_type type)
+{
+    switch (type) {
+        case address_wots_hash:
+        case address_tree:
+        case address_fors_tree:
+        case address_keygen_fors:
+            return 2;
+        case address_keygen_wots:
+            return 1;
+        case address_wots_pk:
+        case address_fors_roots:
+        case address_sign_msg_wots:
+        default:
+            return 0;
+    }
+}
 
-void hypericum_adrs_set_layer_address(hypericum_adrs_t* adrs, uint32_t value);
+static inline void hypericum_adrs_set_data(
+    hypericum_adrs_t* adrs, uint32_t word, uint32_t value)
+{
+    adrs->data[word] = value;
+    if (word < hypericum_adrs_data_words(adrs->type)) {
+        hypericum_adrs_store32(
+            adrs->bytes + HYP_ADRS_DATA_OFFSET + 4 * word, value);
+    }
+}
+
+// Initializes all words of the address to zero.
+static inline void hypericum_adrs_init(hypericum_adrs_t* adrs)
+{
+    memset(adrs, 0, sizeof(hypericum_adrs_t));
+}
+
+static inline const uint8_t* hypericum_adrs_bytes(const hypericum_adrs_t* adrs)
+{
+    return adrs->bytes;
+}
+
+static inline void hypericum_adrs_get_bytes(
+    const hypericum_adrs_t* adrs, uint8_t* value)
+{
+    memcpy(value, adrs->bytes, HYPERICUM_ADRS_SIZE_BYTES);
+}
+
+static inline void hypericum_adrs_set_layer_address(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_store32(adrs->bytes + HYP_ADRS_LAYER_OFFSET, value);
+}
 
 // 64-bit tree_address is used instead of 96-bit because of
 // ease of implementation and slight difference in safety.
-void hypericum_adrs_set_tree_address(hypericum_adrs_t* adrs, uint64_t value);
+static inline void hypericum_adrs_set_tree_address(
+    hypericum_adrs_t* adrs, uint64_t value)
+{
+    hypericum_adrs_store32(
+        adrs->bytes + HYP_ADRS_TREE_OFFSET, (uint32_t)(value >> 32));
+    hypericum_adrs_store32(
+        adrs->bytes + HYP_ADRS_TREE_OFFSET + 4, (uint32_t)value);
+}
+
+static inline void hypericum_adrs_set_keypair_address(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_store32(adrs->bytes + HYP_ADRS_KEYPAIR_OFFSET, value);
+}
+
+// Re-renders the data words for the new type. Switching to address_tree
+// resets the keypair address.
+static inline void hypericum_adrs_set_type(
+    hypericum_adrs_t* adrs, enum address_type value)
+{
+    adrs->type = value;
+    hypericum_adrs_store32(
+        adrs->bytes + HYP_ADRS_TYPE_OFFSET, (uint32_t)value);
+
+    const uint32_t words = hypericum_adrs_data_words(value);
+    for (uint32_t i = 0; i < 2; ++i) {
+        hypericum_adrs_store32(
+            adrs->bytes + HYP_ADRS_DATA_OFFSET + 4 * i,
+            i < words ? adrs->data[i] : 0);
+    }
+
+    if (value == address_tree) {
+        hypericum_adrs_set_keypair_address(adrs, 0);
+    }
+}
+
+static inline enum address_type hypericum_adrs_get_type(
+    const hypericum_adrs_t* adrs)
+{
+    return adrs->type;
+}
+
+static inline void hypericum_adrs_set_wots_hash_chain_address(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 0, value);
+}
+
+static inline void hypericum_adrs_set_wots_hash_hash_address(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 1, value);
+}
+
+static inline void hypericum_adrs_set_tree_height(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 0, value);
+}
+
+static inline uint32_t hypericum_adrs_get_tree_height(
+    const hypericum_adrs_t* adrs)
+{
+    return adrs->data[0];
+}
+
+static inline void hypericum_adrs_set_tree_index(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 1, value);
+}
+
+static inline uint32_t hypericum_adrs_get_tree_index(
+    const hypericum_adrs_t* adrs)
+{
+    return adrs->data[1];
+}
+
+static inline void hypericum_adrs_set_fors_tree_height(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 0, value);
+}
+
+static inline uint32_t hypericum_adrs_get_fors_tree_height(
+    const hypericum_adrs_t* adrs)
+{
+    return adrs->data[0];
+}
+
+static inline void hypericum_adrs_set_fors_tree_index(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 1, value);
+}
+
+static inline uint32_t hypericum_adrs_get_fors_tree_index(
+    const hypericum_adrs_t* adrs)
+{
+    return adrs->data[1];
+}
+
+static inline void hypericum_adrs_set_keygen_wots_chain_address(
+    hypericum_adrs_t* adrs, uint32_t value)
+{
+    hypericum_adrs_set_data(adrs, 0, value);
+}
 
-void hypericum_adrs_set_type(hypericum_adrs_t* adrs, enum address_type value);
-enum address_type hypericum_adrs_get_type(const hypericum_adrs_t* adrs);
+static inline void hypericum_adrs_set_suffix(
+    hypericum_adrs_t* adrs, uint64_t suffix)
+{
+    switch (adrs->type) {
+        case address_keygen_wots:
+            hypericum_adrs_set_data(adrs, 0, (uint32_t)suffix);
+            break;
+        case address_wots_hash:
+        case address_tree:
+        case address_fors_tree:
+        case address_keygen_fors:
+            hypericum_adrs_set_data(adrs, 0, (uint32_t)(suffix >> 32));
+            hypericum_adrs_set_data(adrs, 1, (uint32_t)suffix);
+            break;
+        default:
+            break;
+    }
+}
 
-void hypericum_adrs_set_tree_height(hypericum_adrs_t* adrs, uint32_t value);
+/* Number of addresses in a batch, one per hash lane. */
+#define HYPERICUM_ADRS_BATCH_LANES 4
 
-uint32_t hypericum_adrs_get_tree_height(const hypericum_adrs_t* adrs);
+/**
+ * Addresses of up to `HYPERICUM_ADRS_BATCH_LANES` hash lanes hashed in
+ * lockstep. The lanes differ only in the data words (chain and hash address,
+ * tree height and index), so `adrs` holds the shared layer, tree, type and
+ * keypair words and `data` the words of every lane.
+ *
+ * `adrs` stays a standalone address for single hashes in between, its own
+ * data words are not used by the lanes. The byte image of a lane is rendered
+ * with `hypericum_adrs_batch_write` straight into the lane's hash input.
+ */
+typedef struct hypericum_adrs_batch_st
+{
+    hypericum_adrs_t adrs;
+    uint32_t data[HYPERICUM_ADRS_BATCH_LANES][2];
+} hypericum_adrs_batch_t;
 
+// Takes `adrs` as the template of all lanes.
+static inline void hypericum_adrs_batch_init(
+    hypericum_adrs_batch_t* batch, const hypericum_adrs_t* adrs)
+{
+    batch->adrs = *adrs;
+    for (size_t l = 0; l < HYPERICUM_ADRS_BATCH_LANES; ++l) {
+        batch->data[l][0] = adrs->data[0];
+        batch->data[l][1] = adrs->data[1];
+    }
+}
 
-void hypericum_adrs_set_tree_index(hypericum_adrs_t* adrs, uint32_t value);
+static inline void hypericum_adrs_batch_set_data(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t word, uint32_t value)
+{
+    batch->data[lane][word] = value;
+}
 
-uint32_t hypericum_adrs_get_tree_index(const hypericum_adrs_t* adrs);
+// Moves the data words of lane `from` to lane `to`.
+static inline void hypericum_adrs_batch_move_lane(
+    hypericum_adrs_batch_t* batch, size_t to, size_t from)
+{
+    batch->data[to][0] = batch->data[from][0];
+    batch->data[to][1] = batch->data[from][1];
+}
 
-void hypericum_adrs_set_keypair_address(hypericum_adrs_t* adrs, uint32_t value);
+// Writes the `HYPERICUM_ADRS_SIZE_BYTES` image of lane `lane` to `out`.
+static inline void hypericum_adrs_batch_write(
+    const hypericum_adrs_batch_t* batch, size_t lane, uint8_t* out)
+{
+    const uint32_t words = hypericum_adrs_data_words(batch->adrs.type);
 
-void hypericum_adrs_set_fors_tree_height(
-    hypericum_adrs_t* adrs, uint32_t value);
+    memcpy(out, batch->adrs.bytes, HYP_ADRS_DATA_OFFSET);
+    for (uint32_t i = 0; i < 2; ++i) {
+        hypericum_adrs_store32(
+            out + HYP_ADRS_DATA_OFFSET + 4 * i,
+            i < words ? batch->data[lane][i] : 0);
+    }
+}
 
-uint32_t hypericum_adrs_get_fors_tree_height(const hypericum_adrs_t* adrs);
+static inline void hypericum_adrs_batch_set_wots_hash_chain_address(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 0, value);
+}
 
-void hypericum_adrs_set_fors_tree_index(hypericum_adrs_t* adrs, uint32_t value);
+static inline void hypericum_adrs_batch_set_wots_hash_hash_address(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 1, value);
+}
 
-uint32_t hypericum_adrs_get_fors_tree_index(const hypericum_adrs_t* adrs);
+static inline void hypericum_adrs_batch_set_tree_height(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 0, value);
+}
 
-void hypericum_adrs_set_keygen_wots_chain_address(
-    hypericum_adrs_t* adrs, uint32_t value);
+static inline void hypericum_adrs_batch_set_tree_index(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 1, value);
+}
 
-void hypericum_adrs_get_bytes(const hypericum_adrs_t* adrs, uint8_t* value);
+static inline void hypericum_adrs_batch_set_fors_tree_height(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 0, value);
+}
 
-void hypericum_adrs_set_suffix(hypericum_adrs_t* adrs, uint64_t suffix);
+static inline void hypericum_adrs_batch_set_fors_tree_index(
+    hypericum_adrs_batch_t* batch, size_t lane, uint32_t value)
+{
+    hypericum_adrs_batch_set_data(batch, lane, 1, value);
+}
@@ -31,8 +31,20 @@
 
 #include <string.h>
 
-static drbg_state DRBG_ctx = { .entropy_source = { 0 },
-                               .is_hardware_based = 1 };
+// Every thread draws from a generator of its own, so that threads signing
+// at the same time never share a state
+#if !defined(WITH_THREADS)
+#define DRBG_THREAD_LOCAL
+#elif defined(_MSC_VER)
+#define DRBG_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define DRBG_THREAD_LOCAL _Thread_local
+#else
+#define DRBG_THREAD_LOCAL __thread
+#endif
+
+static DRBG_THREAD_LOCAL drbg_state DRBG_ctx = { .entropy_source = { 0 },
+                                                 .is_hardware_based = 1 };
 
 void randombytes_init(uint8_t* entropy_input)
 {
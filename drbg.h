@@ -39,8 +39,9 @@ typedef struct drbg_state
     uint8_t is_hardware_based;
 } drbg_state;
 
-// Initialize drbg state, if entropy_input is NULL use hardware randomness, else
-// deduce it from initial seed
+// Initialize drbg state of the calling thread, if entropy_input is NULL use
+// hardware randomness, else deduce it from initial seed. Other threads keep
+// drawing hardware randomness.
 void randombytes_init(uint8_t* entropy_input);
 
 // Р 1323565.1.006-2017 standard
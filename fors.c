@@ -27,8 +27,8 @@
 #include "fors.h"
 
 #include "hash.h"
+#include "parallel.h"
 #include "params.h"
-#include "stack.h"
 #include "utils.h"
 
 #include <string.h>
@@ -49,130 +49,445 @@ void hypericum_generate_fors_sk(
     hypericum_prf(hash_algo, sk_seed, pk_seed, adrs, result);
 }
 
-// 'sk_seed' len: n
-// 'pk_seed' len: n
-// 'result' len: n
-void hypericum_fors_tree_hash(
+// Upper bound for the level array of one group of FORS+C trees. Trees of a
+// group are built together, so that every level of the whole group is fed to
+// the lane hash functions at once. Trees larger than the bound form a group of
+// their own.
+#define HYP_FORS_GROUP_BYTES (4u << 20)
+#define HYP_FORS_TREE_BYTES ((size_t)HYPERICUM_N_BYTES << HYP_B)
+
+static uint32_t fors_group_trees()
+{
+    size_t trees = HYP_FORS_GROUP_BYTES / HYP_FORS_TREE_BYTES;
+    if (trees == 0) {
+        return 1;
+    }
+    if (trees > HYP_K_HATCH) {
+        return HYP_K_HATCH;
+    }
+    return (uint32_t)trees;
+}
+
+// Computes `count` consecutive FORS+C leaves starting from the global leaf
+// index `first` into `nodes`.
+static void fors_leaves(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
-    uint32_t start_index,
-    uint32_t target_node_h,
-    hypericum_adrs_t* adrs,
-    uint8_t* result)
+    hypericum_adrs_batch_t* lane_adrs,
+    uint32_t first,
+    uint32_t count,
+    uint8_t* nodes)
 {
-    stack_root_t* stack_root_node = NULL;
-
-    uint8_t sk[HYPERICUM_N_BYTES];
-
-    for (uint32_t i = 0; i < (1u << target_node_h); i++) {
-        hypericum_generate_fors_sk(
-            hash_algo, sk_seed, pk_seed, start_index + i, adrs, sk);
+    uint8_t sk[HYPERICUM_HASH_LANES * HYPERICUM_N_BYTES];
+    uint8_t* sk_ptr[HYPERICUM_HASH_LANES];
+    uint8_t* leaf_ptr[HYPERICUM_HASH_LANES];
+
+    for (uint32_t i = 0; i < count; i += HYPERICUM_HASH_LANES) {
+        size_t lanes = count - i < HYPERICUM_HASH_LANES ? count - i
+                                                        : HYPERICUM_HASH_LANES;
+        for (size_t l = 0; l < lanes; l++) {
+            hypericum_adrs_batch_set_fors_tree_height(lane_adrs, l, 0);
+            hypericum_adrs_batch_set_fors_tree_index(
+                lane_adrs, l, first + i + l);
+            sk_ptr[l] = sk + l * HYPERICUM_N_BYTES;
+            leaf_ptr[l] = nodes + (i + l) * HYPERICUM_N_BYTES;
+        }
+        hypericum_prf_lanes(
+            hash_algo, sk_seed, pk_seed, lane_adrs, sk_ptr, lanes);
+        hypericum_f_lanes(
+            hash_algo, pk_seed, lane_adrs, (const uint8_t* const*)sk_ptr,
+            leaf_ptr, lanes);
+    }
 
-        uint32_t node_h = 0;
-        struct Node* node = hypericum_create_node(node_h);
+    SECURE_ERASE(uint8_t, sk, HYPERICUM_HASH_LANES * HYPERICUM_N_BYTES);
+}
 
-        hypericum_f(hash_algo, pk_seed, adrs, sk, node->pk);
+// Replaces `2 * count` nodes of height `height - 1` in `nodes` by their
+// `count` parents. `first` is the global tree index of the first parent.
+static void fors_reduce_level(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    hypericum_adrs_batch_t* lane_adrs,
+    uint32_t height,
+    uint32_t first,
+    uint32_t count,
+    uint8_t* nodes)
+{
+    const uint8_t* left[HYPERICUM_HASH_LANES];
+    const uint8_t* right[HYPERICUM_HASH_LANES];
+    uint8_t* parent[HYPERICUM_HASH_LANES];
+
+    for (uint32_t j = 0; j < count; j += HYPERICUM_HASH_LANES) {
+        size_t lanes = count - j < HYPERICUM_HASH_LANES ? count - j
+                                                        : HYPERICUM_HASH_LANES;
+        for (size_t l = 0; l < lanes; l++) {
+            hypericum_adrs_batch_set_fors_tree_height(lane_adrs, l, height);
+            hypericum_adrs_batch_set_fors_tree_index(
+                lane_adrs, l, first + j + l);
+            left[l] = nodes + 2 * (j + l) * HYPERICUM_N_BYTES;
+            right[l] = left[l] + HYPERICUM_N_BYTES;
+            parent[l] = nodes + (j + l) * HYPERICUM_N_BYTES;
+        }
+        hypericum_h_node_lanes(
+            hash_algo, pk_seed, lane_adrs, left, right, parent, lanes);
+    }
+}
 
-        hypericum_adrs_set_fors_tree_height(adrs, node_h + 1);
-        hypericum_adrs_set_fors_tree_index(adrs, start_index + i);
+// Bytes of the message digest covered by the FORS+C indices.
+#define HYP_FORS_MSG_BYTES ((HYP_K_HATCH * HYP_B + 7) / 8)
 
-        while (!stack_is_empty(stack_root_node) &&
-               ((struct Node*)stack_peek(stack_root_node))->h == node_h) {
-            hypericum_adrs_set_fors_tree_index(
-                adrs, (hypericum_adrs_get_fors_tree_index(adrs) - 1) / 2);
+// An index with its in-byte shift fits in one 32-bit load.
+#if HYP_B > 25
+#error "FORS+C index extraction assumes HYP_B <= 25"
+#endif
 
-            struct Node* top_stack_node =
-                (struct Node*)stack_pop(&stack_root_node);
+static inline uint32_t load32_le(const unsigned char* m)
+{
+    return (uint32_t)m[0] | ((uint32_t)m[1] << 8) | ((uint32_t)m[2] << 16) |
+           ((uint32_t)m[3] << 24);
+}
 
-            hypericum_h_node(
-                hash_algo, pk_seed, adrs, top_stack_node->pk, node->pk,
-                node->pk);
+// Reverses the low HYP_B bits of `x`.
+static inline uint32_t reverse_index_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    x = (x >> 16) | (x << 16);
+    return x >> (32 - HYP_B);
+}
 
-            secure_erase(top_stack_node->pk, HYPERICUM_N_BYTES);
-            free(top_stack_node);
+// Index `i` made of bits `i * HYP_B`, ..., `i * HYP_B + HYP_B - 1` of `m`,
+// taken least significant bit of a byte first. The first bit taken is the
+// most significant bit of the index.
+static inline uint32_t index_at(const unsigned char* m, uint32_t i)
+{
+    const uint32_t offset = i * HYP_B;
+    const uint32_t mask = (1u << HYP_B) - 1;
+    const unsigned char* p = m + (offset >> 3);
+    uint32_t word;
+
+    if ((offset >> 3) + 4 <= HYP_FORS_MSG_BYTES) {
+        word = load32_le(p);
+    } else {
+        // the last indices can't load past the end of the message
+        word = 0;
+        for (uint32_t j = 0; (offset >> 3) + j < HYP_FORS_MSG_BYTES; j++) {
+            word |= (uint32_t)p[j] << (8 * j);
+        }
+    }
+    return reverse_index_bits((word >> (offset & 7)) & mask);
+}
 
-            node_h = hypericum_adrs_get_fors_tree_height(adrs);
-            hypericum_adrs_set_fors_tree_height(adrs, node_h + 1);
+/**
+ * Interprets m as HYP_B-bit unsigned integers, HYP_K_HATCH of them.
+ * Assumes m contains at least HYP_B * HYP_K_HATCH bits.
+ * Every 8 indices take exactly HYP_B bytes, so inside a block of 8 indices
+ * the byte offsets and shifts are compile time constants; the loop below is
+ * unrolled by the compiler into fixed loads and shifts for the parameter set.
+ */
+static void message_to_indices(uint32_t* indices, const unsigned char* m)
+{
+    uint32_t i = 0;
+
+    // blocks whose last load stays inside the message
+    for (; i + 8 <= HYP_K_HATCH &&
+           (i / 8) * HYP_B + ((7 * HYP_B) >> 3) + 4 <= HYP_FORS_MSG_BYTES;
+         i += 8) {
+        const unsigned char* block = m + (i / 8) * HYP_B;
+        for (uint32_t j = 0; j < 8; j++) {
+            indices[i + j] = reverse_index_bits(
+                (load32_le(block + ((j * HYP_B) >> 3)) >> ((j * HYP_B) & 7)) &
+                ((1u << HYP_B) - 1));
         }
-        node->h = node_h;
-        stack_push(&stack_root_node, node);
     }
+    for (; i < HYP_K_HATCH; i++) {
+        indices[i] = index_at(m, i);
+    }
+}
 
-    // secure sensitive data
-    SECURE_ERASE(uint8_t, sk, HYPERICUM_N_BYTES);
 
-    struct Node* top_node = (struct Node*)stack_peek(stack_root_node);
-    memcpy(result, top_node->pk, HYPERICUM_N_BYTES);
+// Builds the trees `first`, ..., `first + trees - 1` together in the level
+// array `nodes`. The auth path node of every tree at height `h` is taken
+// before the level is replaced by its parents; the roots are left at the
+// beginning of `nodes`.
+static void fors_build_group(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_batch_t* lane_adrs,
+    const uint32_t* indices,
+    uint32_t first,
+    uint32_t trees,
+    uint8_t* nodes,
+    uint8_t* result)
+{
+    const uint32_t t = (1u << HYP_B);
+    const size_t tree_sig_bytes = (HYP_B + 1) * HYPERICUM_N_BYTES;
+
+    fors_leaves(
+        hash_algo, sk_seed, pk_seed, lane_adrs, first * t, trees * t, nodes);
+
+    for (uint32_t h = 0; h < HYP_B; h++) {
+        const uint32_t level_width = t >> h;
+        for (uint32_t i = 0; i < trees; i++) {
+            const uint32_t sibling = (indices[first + i] >> h) ^ 1;
+            memcpy(
+                result + (first + i) * tree_sig_bytes +
+                    (h + 1) * HYPERICUM_N_BYTES,
+                nodes + (i * level_width + sibling) * HYPERICUM_N_BYTES,
+                HYPERICUM_N_BYTES);
+        }
 
-    // clear stack and free all the data if needed
-    while (!stack_is_empty(stack_root_node)) {
-        struct Node* node = (struct Node*)stack_pop(&stack_root_node);
-        secure_erase(node->pk, HYPERICUM_N_BYTES);
-        free(node);
+        fors_reduce_level(
+            hash_algo, pk_seed, lane_adrs, h + 1, (first * t) >> (h + 1),
+            (trees * t) >> (h + 1), nodes);
     }
 }
 
-/**
- * Interprets m as FORS_HEIGHT-bit unsigned integers.
- * Assumes m contains at least FORS_HEIGHT * FORS_TREES bits.
- * Assumes indices have space for FORS_TREES integers.
- * PK: This code is copied from the reference code as there are
- * some objections about its implementation
- */
-static void message_to_indices(uint32_t* indices, const unsigned char* m)
+// Treehash over all leaves of the tree `tree` in one pass. Nodes of the auth
+// path of leaf `idx` are copied to `auth` as soon as they are complete, the
+// last node left on the stack is the tree root.
+static void fors_tree_hash_auth(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_batch_t* lane_adrs,
+    uint32_t tree,
+    uint32_t idx,
+    uint8_t* auth,
+    uint8_t* root)
 {
-    uint32_t i, j;
-    uint32_t offset = 0;
-
-    for (i = 0; i < HYP_K_HATCH; i++) {
-        indices[i] = 0;
-        for (j = 0; j < HYP_B; j++) {
-            indices[i] <<= 1;
-            indices[i] ^= (m[offset >> 3] >> (offset & 0x7)) & 0x1;
-            offset++;
+    const uint32_t t = (1u << HYP_B);
+    uint8_t leaves[HYPERICUM_HASH_LANES * HYPERICUM_N_BYTES];
+    hypericum_treehash_stack_t stack;
+    stack.size = 0;
+
+    for (uint32_t i = 0; i < t; i += HYPERICUM_HASH_LANES) {
+        const uint32_t count = t - i < HYPERICUM_HASH_LANES
+                                   ? t - i
+                                   : HYPERICUM_HASH_LANES;
+        fors_leaves(
+            hash_algo, sk_seed, pk_seed, lane_adrs, tree * t + i, count,
+            leaves);
+
+        for (uint32_t l = 0; l < count; l++) {
+            uint8_t* node = stack.nodes + stack.size * HYPERICUM_N_BYTES;
+            uint32_t node_h = 0;
+            // index of the node inside the tree at height node_h
+            uint32_t node_idx = i + l;
+            memcpy(node, leaves + l * HYPERICUM_N_BYTES, HYPERICUM_N_BYTES);
+
+            for (;;) {
+                if (node_h < HYP_B && node_idx == ((idx >> node_h) ^ 1)) {
+                    memcpy(
+                        auth + node_h * HYPERICUM_N_BYTES, node,
+                        HYPERICUM_N_BYTES);
+                }
+                if (stack.size == 0 ||
+                    stack.heights[stack.size - 1] != node_h) {
+                    break;
+                }
+
+                // the parent replaces the left node on top of the stack
+                uint8_t* top = node - HYPERICUM_N_BYTES;
+                node_h++;
+                node_idx >>= 1;
+                hypericum_adrs_set_fors_tree_height(
+                    &lane_adrs->adrs, node_h);
+                hypericum_adrs_set_fors_tree_index(
+                    &lane_adrs->adrs, tree * (t >> node_h) + node_idx);
+                hypericum_h_node(
+                    hash_algo, pk_seed, &lane_adrs->adrs, top, node, top);
+                secure_erase(node, HYPERICUM_N_BYTES);
+                node = top;
+                stack.size--;
+            }
+            stack.heights[stack.size++] = node_h;
         }
     }
+
+    memcpy(root, stack.nodes, HYPERICUM_N_BYTES);
+
+    SECURE_ERASE(uint8_t, stack.nodes, sizeof(stack.nodes));
+    SECURE_ERASE(uint8_t, leaves, HYPERICUM_HASH_LANES * HYPERICUM_N_BYTES);
 }
 
 
+// Shared state of one FORS+C signature. Tasks get disjoint ranges of trees
+// and write their secret values, auth paths and roots in place.
+struct fors_sign_job
+{
+    hash_algo_t hash_algo;
+    const uint8_t* sk_seed;
+    const uint8_t* pk_seed;
+    const hypericum_adrs_t* adrs;
+    const uint32_t* indices;
+    uint32_t group;
+    uint8_t* result;
+    uint8_t* roots;
+};
+
+// Signs the trees of group `task` with its own lane addresses and level
+// array, so that groups may run on different threads.
+static int fors_sign_group(void* arg, uint32_t task)
+{
+    const struct fors_sign_job* job = (const struct fors_sign_job*)arg;
+    const uint32_t t = (1u << HYP_B);
+    const size_t tree_sig_bytes = (HYP_B + 1) * HYPERICUM_N_BYTES;
+    const uint32_t first = task * job->group;
+    const uint32_t trees = HYP_K_HATCH - first < job->group
+                               ? HYP_K_HATCH - first
+                               : job->group;
+    // trees above the group bound are built one at a time by the single pass
+    // treehash, which needs no level array at all
+    const int single_pass = HYP_FORS_TREE_BYTES > HYP_FORS_GROUP_BYTES;
+
+    uint8_t* nodes = NULL;
+    if (!single_pass) {
+        nodes = (uint8_t*)malloc(trees * HYP_FORS_TREE_BYTES);
+        if (NULL == nodes) {
+            return ENOMEM;
+        }
+    }
+
+    hypericum_adrs_batch_t lane_adrs;
+    hypericum_adrs_batch_init(&lane_adrs, job->adrs);
+
+    for (uint32_t i = first; i < first + trees; i++) {
+        hypericum_generate_fors_sk(
+            job->hash_algo, job->sk_seed, job->pk_seed,
+            i * t + job->indices[i], &lane_adrs.adrs,
+            job->result + i * tree_sig_bytes);
+    }
+
+    if (single_pass) {
+        for (uint32_t i = first; i < first + trees; i++) {
+            fors_tree_hash_auth(
+                job->hash_algo, job->sk_seed, job->pk_seed, &lane_adrs, i,
+                job->indices[i],
+                job->result + i * tree_sig_bytes + HYPERICUM_N_BYTES,
+                job->roots + i * HYPERICUM_N_BYTES);
+        }
+    } else {
+        fors_build_group(
+            job->hash_algo, job->sk_seed, job->pk_seed, &lane_adrs,
+            job->indices, first, trees, nodes, job->result);
+        memcpy(
+            job->roots + first * HYPERICUM_N_BYTES, nodes,
+            trees * HYPERICUM_N_BYTES);
+    }
+
+    if (NULL != nodes) {
+        secure_erase(nodes, trees * HYP_FORS_TREE_BYTES);
+        free(nodes);
+    }
+    return 0;
+}
+
 // 'sk_seed' len: n
 // 'pk_seed' len: n
 // 'msg' len: fors_msg_bytes
 // 'result' len: fors_bytes
-void hypericum_sign_fors(
+// 'pk_fors' len: fors_pk_bytes (== n)
+int hypericum_sign_fors(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
     const uint8_t* msg,
     hypericum_adrs_t* adrs,
-    uint8_t* result)
+    uint8_t* result,
+    uint8_t* pk_fors)
 {
-    uint32_t t = (1u << HYP_B);
+    const unsigned threads = hypericum_parallel_threads();
+    uint32_t group = fors_group_trees();
+    // split the trees into at least one group per thread
+    if (threads > 1 && group > (HYP_K_HATCH + threads - 1) / threads) {
+        group = (HYP_K_HATCH + threads - 1) / threads;
+    }
 
     ALLOC_ON_STACK(uint32_t, indices, HYP_K_HATCH);
+    ALLOC_ON_STACK(uint8_t, roots, HYP_K_HATCH * HYPERICUM_N_BYTES);
 
     message_to_indices(indices, msg);
 
-    for (uint32_t i = 0; i < HYP_K_HATCH; i++) {
-        uint32_t idx = indices[i];
+    hypericum_adrs_set_type(adrs, address_fors_tree);
 
-        hypericum_generate_fors_sk(
-            hash_algo, sk_seed, pk_seed, i * t + idx, adrs, result);
-        result += HYPERICUM_N_BYTES;
-
-        for (uint32_t j = 0; j < HYP_B; j++) {
-            uint32_t s = (idx / (1u << j)) ^ 1;
-            hypericum_fors_tree_hash(
-                hash_algo, sk_seed, pk_seed, i * t + s * (1u << j), j, adrs,
-                result);
-            result += HYPERICUM_N_BYTES;
-        }
-    }
+    struct fors_sign_job job = {
+        .hash_algo = hash_algo,
+        .sk_seed = sk_seed,
+        .pk_seed = pk_seed,
+        .adrs = adrs,
+        .indices = indices,
+        .group = group,
+        .result = result,
+        .roots = roots,
+    };
+    int ret = hypericum_parallel_for(
+        (HYP_K_HATCH + group - 1) / group, fors_sign_group, &job);
     SECURE_ERASE(uint32_t, indices, HYP_K_HATCH);
+
+    if (ret == 0) {
+        hypericum_adrs_set_type(adrs, address_fors_roots);
+        hypericum_thk(hash_algo, pk_seed, adrs, roots, pk_fors);
+    }
+
+    SECURE_ERASE(uint8_t, roots, HYP_K_HATCH * HYPERICUM_N_BYTES);
+    return ret;
 }
 
 
+// Climbs the trees `first`, ..., `first + lanes - 1` from their signed leaves
+// to the roots in lockstep, one lane per tree.
+static void fors_roots_from_sig(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    hypericum_adrs_batch_t* lane_adrs,
+    const uint32_t* indices,
+    const uint8_t* sig,
+    uint32_t first,
+    size_t lanes,
+    uint8_t* roots)
+{
+    const uint32_t t = (1u << HYP_B);
+    const size_t tree_sig_bytes = (HYP_B + 1) * HYPERICUM_N_BYTES;
+    const uint8_t* sk[HYPERICUM_HASH_LANES];
+    const uint8_t* left[HYPERICUM_HASH_LANES];
+    const uint8_t* right[HYPERICUM_HASH_LANES];
+    uint8_t* node[HYPERICUM_HASH_LANES];
+
+    for (size_t l = 0; l < lanes; l++) {
+        hypericum_adrs_batch_set_fors_tree_height(lane_adrs, l, 0);
+        hypericum_adrs_batch_set_fors_tree_index(
+            lane_adrs, l, (first + l) * t + indices[first + l]);
+        sk[l] = sig + (first + l) * tree_sig_bytes;
+        node[l] = roots + (first + l) * HYPERICUM_N_BYTES;
+    }
+    hypericum_f_lanes(hash_algo, pk_seed, lane_adrs, sk, node, lanes);
+
+    for (uint32_t j = 0; j < HYP_B; j++) {
+        for (size_t l = 0; l < lanes; l++) {
+            const uint32_t idx = indices[first + l];
+            const uint8_t* auth = sk[l] + (j + 1) * HYPERICUM_N_BYTES;
+
+            hypericum_adrs_batch_set_fors_tree_height(lane_adrs, l, j + 1);
+            hypericum_adrs_batch_set_fors_tree_index(
+                lane_adrs, l, ((first + l) * t + idx) >> (j + 1));
+            if (((idx >> j) & 1) == 0) {
+                left[l] = node[l];
+                right[l] = auth;
+            } else {
+                left[l] = auth;
+                right[l] = node[l];
+            }
+        }
+        hypericum_h_node_lanes(
+            hash_algo, pk_seed, lane_adrs, left, right, node, lanes);
+    }
+}
+
 // 'pk_seed' len: n
 // 'msg' len: fors_msg_bytes
 // 'sig' len: fors_bytes
@@ -185,43 +500,22 @@ void hypericum_generate_fors_pk_from_sig(
     hypericum_adrs_t* adrs,
     uint8_t* result)
 {
-    uint32_t t = (1u << HYP_B);
+    hypericum_adrs_batch_t lane_adrs;
+
+    hypericum_adrs_set_type(adrs, address_fors_tree);
+    hypericum_adrs_batch_init(&lane_adrs, adrs);
 
     ALLOC_ON_STACK(uint32_t, indices, HYP_K_HATCH);
     ALLOC_ON_STACK(uint8_t, roots, HYP_K_HATCH * HYPERICUM_N_BYTES);
 
     message_to_indices(indices, msg);
-    uint8_t* roots_ptr = roots;
-
-    hypericum_adrs_set_type(adrs, address_fors_tree);
-    for (uint32_t i = 0; i < HYP_K_HATCH; i++) {
-        // NOLINTNEXTLINE(clang-analyzer-core.uninitialized.Assign)
-        uint32_t idx = indices[i];
-        hypericum_adrs_set_fors_tree_height(adrs, 0);
-        hypericum_adrs_set_fors_tree_index(adrs, i * t + idx);
-
-        const uint8_t* sk = sig;
-        hypericum_f(hash_algo, pk_seed, adrs, sk, roots_ptr);
-        sig += HYPERICUM_N_BYTES;
-
-        for (uint32_t j = 0; j < HYP_B; j++) {
-            const uint8_t* auth = sig;
-            hypericum_adrs_set_fors_tree_height(adrs, j + 1);
-            if ((idx / (1u << j)) % 2 == 0) {
-                hypericum_adrs_set_fors_tree_index(
-                    adrs, hypericum_adrs_get_fors_tree_index(adrs) / 2);
 
-                hypericum_h_node(
-                    hash_algo, pk_seed, adrs, roots_ptr, auth, roots_ptr);
-            } else {
-                hypericum_adrs_set_fors_tree_index(
-                    adrs, (hypericum_adrs_get_fors_tree_index(adrs) - 1) / 2);
-                hypericum_h_node(
-                    hash_algo, pk_seed, adrs, auth, roots_ptr, roots_ptr);
-            }
-            sig += HYPERICUM_N_BYTES;
-        }
-        roots_ptr += HYPERICUM_N_BYTES;
+    for (uint32_t i = 0; i < HYP_K_HATCH; i += HYPERICUM_HASH_LANES) {
+        const size_t lanes = HYP_K_HATCH - i < HYPERICUM_HASH_LANES
+                                 ? HYP_K_HATCH - i
+                                 : HYPERICUM_HASH_LANES;
+        fors_roots_from_sig(
+            hash_algo, pk_seed, &lane_adrs, indices, sig, i, lanes, roots);
     }
     SECURE_ERASE(uint32_t, indices, HYP_K_HATCH);
 
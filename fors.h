@@ -59,15 +59,21 @@ void hypericum_generate_fors_sk(
  * @param[in] `pk_seed` Public key seed, length is `HYPERICUM_N_BYTES`.
  * @param[in] msg Message of size `forsc_msg_bytes`.
  * @param[in] adrs hypericum addressing structure.
- * @param[out] result `HYPERICUM_N_BYTES` hash result.
+ * @param[out] result FORS+C signature of size `HYP_FORSC_BYTES`.
+ * @param[out] pk_fors FORS+C public key of size `HYPERICUM_N_BYTES`, the
+ * same value `hypericum_generate_fors_pk_from_sig` returns for `result`.
+ * Groups of trees are signed in parallel when `hypericum_set_threads` allows
+ * more than one thread.
+ * @return 0 on success, ENOMEM if the level arrays can't be allocated.
  */
-void hypericum_sign_fors(
+int hypericum_sign_fors(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
     const uint8_t* msg,
     hypericum_adrs_t* adrs,
-    uint8_t* result);
+    uint8_t* result,
+    uint8_t* pk_fors);
 
 
 /**
@@ -79,6 +85,8 @@ void hypericum_sign_fors(
  * @param[in] sig FORS signature of size `HYPERICUM_N_BYTES`.
  * @param[in] adrs hypericum addressing structure.
  * @param[out] result `HYPERICUM_N_BYTES` hash result.
+ *
+ * The trees are climbed `HYPERICUM_HASH_LANES` at a time in lockstep.
  */
 void hypericum_generate_fors_pk_from_sig(
     const hash_algo_t hash_algo,
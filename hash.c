@@ -34,9 +34,132 @@
 
 #include <string.h>
 
+// HMAC key states: contexts that have absorbed K XOR 0x36 and K XOR 0x5c
+struct hmac_key_st
+{
+    hash_function_ctx_t ipad;
+    hash_function_ctx_t opad;
+};
+
+// States of one key pair, see `hypericum_hash_set_keys`
+struct hypericum_hash_keys_st
+{
+    uint8_t pk_seed[HYPERICUM_N_BYTES];
+    // tweakable hash prefix pk_seed || zeros
+    hash_function_ctx_t th_prefix;
+    // HMAC keys sk_seed and sk_prf, unused entries have no states
+    struct hmac_key_st hmac[2];
+};
+
+// Role of an HMAC key. The precomputed states of a secret key are selected
+// by its role only: secret key bytes are never compared, and keys that are
+// not secret, as the randomizer of H_msg, never select them.
+enum hmac_key_slot
+{
+    hmac_key_sk_seed = 0,
+    hmac_key_sk_prf = 1,
+    hmac_key_other = 2,
+};
+
+// Absorbs the 64 byte HMAC key block K XOR `pad`.
+static void hmac_absorb_key(
+    const hash_algo_t streebog,
+    hash_function_ctx_t ctx,
+    const uint8_t *sk,
+    size_t sk_len,
+    uint8_t pad)
+{
+    const size_t k_len = 64;
+    uint8_t K[64];
+
+    for (size_t i = 0; i < sk_len; i++)
+    {
+        K[i] = sk[i] ^ pad;
+    }
+    memset(K + sk_len, pad, k_len - sk_len);
+
+    streebog->ctx_update(ctx, K, k_len);
+
+    secure_erase(K, k_len);
+}
+
+// Precomputed states of the HMAC key in `slot` or NULL.
+static const struct hmac_key_st *hmac_key_states(
+    const hash_algo_t streebog, enum hmac_key_slot slot)
+{
+    if (NULL == streebog->keys || slot == hmac_key_other ||
+        NULL == streebog->keys->hmac[slot].ipad)
+    {
+        return NULL;
+    }
+    return &streebog->keys->hmac[slot];
+}
+
+// Precomputed state after pk_seed || zeros or NULL.
+static hash_function_ctx_t th_prefix_state(
+    const hash_algo_t hash_algo, const uint8_t *pk_seed)
+{
+    if (NULL == hash_algo->keys ||
+        memcmp(hash_algo->keys->pk_seed, pk_seed, HYPERICUM_N_BYTES) != 0)
+    {
+        return NULL;
+    }
+    return hash_algo->keys->th_prefix;
+}
+
+// Starts the inner hash of HMAC with the key `sk`: absorbs K XOR 0x36.
+static void hmac_init(
+    const hash_algo_t streebog,
+    hash_function_ctx_t ctx,
+    enum hmac_key_slot slot,
+    const uint8_t *sk,
+    size_t sk_len)
+{
+    const struct hmac_key_st *key = hmac_key_states(streebog, slot);
+
+    if (NULL != key)
+    {
+        streebog->ctx_copy(ctx, key->ipad);
+    }
+    else
+    {
+        streebog->ctx_init(ctx);
+        hmac_absorb_key(streebog, ctx, sk, sk_len, 0x36);
+    }
+}
+
+// Finishes the inner hash in `ctx` and computes the outer one into `result`.
+static void hmac_final(
+    const hash_algo_t streebog,
+    hash_function_ctx_t ctx,
+    enum hmac_key_slot slot,
+    const uint8_t *sk,
+    size_t sk_len,
+    uint8_t *result)
+{
+    const struct hmac_key_st *key = hmac_key_states(streebog, slot);
+
+    streebog->ctx_final(ctx, result);
+
+    // start a new hashing round
+    if (NULL != key)
+    {
+        streebog->ctx_copy(ctx, key->opad);
+    }
+    else
+    {
+        streebog->ctx_init(ctx);
+        hmac_absorb_key(streebog, ctx, sk, sk_len, 0x5c);
+    }
+    streebog->ctx_update(ctx, result, streebog->output_size);
+
+    streebog->ctx_final(ctx, result);
+}
+
 // K = sk || [0,..,0]; streebog(K XOR 0x5c || streebog(K XOR 0x36 || msg))
-void hmac_gostr3411_2012_256(
+static void hmac_gostr3411_2012_256(
     const hash_algo_t streebog,
+    enum hmac_key_slot slot,
     const uint8_t *sk,
     size_t sk_len,
     const uint8_t *msg,
@@ -46,41 +169,104 @@ void hmac_gostr3411_2012_256(
     // TODO: pass ctx as a parameter to avoid memory allocation
     hash_function_ctx_new_t ctx = streebog->ctx_new();
 
-    const size_t k_len = 64;
-    ALLOC_ON_STACK(uint8_t, K, k_len);
+    hmac_init(streebog, ctx, slot, sk, sk_len);
+    streebog->ctx_update(ctx, msg, msg_len);
+    hmac_final(streebog, ctx, slot, sk, sk_len, result);
 
-    for (size_t i = 0; i < sk_len; i++)
+    streebog->ctx_free(ctx);
+}
+
+static int hmac_key_set(
+    const hash_algo_t hash_algo, struct hmac_key_st *key, const uint8_t *sk)
+{
+    const size_t n = HYPERICUM_N_BYTES;
+
+    key->ipad = hash_algo->ctx_new();
+    key->opad = hash_algo->ctx_new();
+    if (NULL == key->ipad || NULL == key->opad)
     {
-        K[i] = sk[i] ^ 0x36;
+        return ENOMEM;
     }
-    memset(K + sk_len, 0x36, k_len - sk_len);
+    hmac_absorb_key(hash_algo, key->ipad, sk, n, 0x36);
+    hmac_absorb_key(hash_algo, key->opad, sk, n, 0x5c);
+    return 0;
+}
 
-    streebog->ctx_update(ctx, K, k_len);
-    streebog->ctx_update(ctx, msg, msg_len);
+int hypericum_hash_set_keys(
+    hash_algo_t hash_algo,
+    const uint8_t *pk_seed,
+    const uint8_t *sk_seed,
+    const uint8_t *sk_prf)
+{
+    if (NULL == hash_algo->ctx_copy)
+    {
+        return EINVAL;
+    }
 
-    streebog->ctx_final(ctx, result);
+    hypericum_hash_clear_keys(hash_algo);
 
-    // start a new hashing round
-    streebog->ctx_init(ctx);
+    struct hypericum_hash_keys_st *keys =
+        (struct hypericum_hash_keys_st *)calloc(1, sizeof(*keys));
+    if (NULL == keys)
+    {
+        return ENOMEM;
+    }
+    // assigned before filling, so that clearing frees partial states
+    hash_algo->keys = keys;
 
-    for (size_t i = 0; i < sk_len; i++)
+    const uint8_t zeros[32] = {0};
+    memcpy(keys->pk_seed, pk_seed, HYPERICUM_N_BYTES);
+    keys->th_prefix = hash_algo->ctx_new();
+    if (NULL == keys->th_prefix)
     {
-        K[i] = sk[i] ^ 0x5c;
+        hypericum_hash_clear_keys(hash_algo);
+        return ENOMEM;
     }
-    memset(K + sk_len, 0x5c, k_len - sk_len);
+    hash_algo->ctx_update(keys->th_prefix, pk_seed, HYPERICUM_N_BYTES);
+    hash_algo->ctx_update(keys->th_prefix, zeros, sizeof(zeros));
 
-    streebog->ctx_update(ctx, K, k_len);
-    streebog->ctx_update(ctx, result, streebog->output_size);
+    const uint8_t *sk[2] = {sk_seed, sk_prf};
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (NULL != sk[i] && hmac_key_set(hash_algo, &keys->hmac[i], sk[i]) != 0)
+        {
+            hypericum_hash_clear_keys(hash_algo);
+            return ENOMEM;
+        }
+    }
 
-    streebog->ctx_final(ctx, result);
+    return 0;
+}
 
-    streebog->ctx_free(ctx);
+void hypericum_hash_clear_keys(hash_algo_t hash_algo)
+{
+    struct hypericum_hash_keys_st *keys = hash_algo->keys;
+    if (NULL == keys)
+    {
+        return;
+    }
+
+    hash_function_ctx_t states[] = {
+        keys->th_prefix, keys->hmac[0].ipad, keys->hmac[0].opad,
+        keys->hmac[1].ipad, keys->hmac[1].opad};
+    for (size_t i = 0; i < sizeof(states) / sizeof(states[0]); i++)
+    {
+        if (NULL != states[i])
+        {
+            hash_algo->ctx_free(states[i]);
+        }
+    }
+
+    secure_erase(keys, sizeof(*keys));
+    free(keys);
+    hash_algo->keys = NULL;
 }
 
 // A0 = label||seed, Ai = HMAC(sk, A{i-1})
 // PRF_TLS = HMAC(sk,  A1 || A0) || HMAC(sk, A2 || A0) || ...
-void prf_tls_gostr3411_2012_256(
+static void prf_tls_gostr3411_2012_256(
     const hash_algo_t streebog,
+    enum hmac_key_slot slot,
     const uint8_t *sk,
     size_t sk_len,
     const uint8_t *label,
@@ -101,13 +287,14 @@ void prf_tls_gostr3411_2012_256(
 
     for (size_t i = 0; i < n_blocks; ++i)
     {
-        hmac_gostr3411_2012_256(streebog, sk, sk_len, a_i, a_i_len, tmp);
+        hmac_gostr3411_2012_256(
+            streebog, slot, sk, sk_len, a_i, a_i_len, tmp);
 
         a_i = tmp;
         a_i_len = streebog->output_size;
 
         hmac_gostr3411_2012_256(
-            streebog, sk, sk_len, tmp, tmp_len,
+            streebog, slot, sk, sk_len, tmp, tmp_len,
             result + i * streebog->output_size);
     }
 }
@@ -128,14 +315,20 @@ static inline void _th(
     // TODO: pass ctx as a parameter to avoid memory allocation
     hash_function_ctx_new_t ctx = hash_algo->ctx_new();
 
-    uint8_t adrs_bytes[HYPERICUM_ADRS_SIZE_BYTES];
-    hypericum_adrs_get_bytes(adrs, adrs_bytes);
-
     const uint8_t zeros[32] = {0};
+    const hash_function_ctx_t prefix = th_prefix_state(hash_algo, pk_seed);
 
-    hash_algo->ctx_update(ctx, pk_seed, HYPERICUM_N_BYTES);
-    hash_algo->ctx_update(ctx, zeros, sizeof(zeros));
-    hash_algo->ctx_update(ctx, adrs_bytes, HYPERICUM_ADRS_SIZE_BYTES);
+    if (NULL != prefix)
+    {
+        hash_algo->ctx_copy(ctx, prefix);
+    }
+    else
+    {
+        hash_algo->ctx_update(ctx, pk_seed, HYPERICUM_N_BYTES);
+        hash_algo->ctx_update(ctx, zeros, sizeof(zeros));
+    }
+    hash_algo->ctx_update(
+        ctx, hypericum_adrs_bytes(adrs), HYPERICUM_ADRS_SIZE_BYTES);
     hash_algo->ctx_update(ctx, msg1, msg1_bytes);
     hash_algo->ctx_update(ctx, msg2, msg2_bytes);
 
@@ -155,6 +348,98 @@ void hypericum_f(
     _th(hash_algo, pk_seed, adrs, m, HYPERICUM_N_BITS, NULL, 0, result);
 }
 
+// Bytes in front of the address in the input of the tweakable hashes:
+// pk_seed || 32 zero bytes
+#define HYP_TH_PREFIX_BYTES (HYPERICUM_N_BYTES + 32)
+// Lane input sizes of `hypericum_f_lanes` and `hypericum_h_node_lanes`
+#define HYP_TH_F_BYTES \
+    (HYP_TH_PREFIX_BYTES + HYPERICUM_ADRS_SIZE_BYTES + HYPERICUM_N_BYTES)
+#define HYP_TH_H_BYTES \
+    (HYP_TH_PREFIX_BYTES + HYPERICUM_ADRS_SIZE_BYTES + 2 * HYPERICUM_N_BYTES)
+
+// Lays out the inputs of all lanes as pk_seed || zeros || adrs of the lane,
+// the messages follow at `HYP_TH_PREFIX_BYTES + HYPERICUM_ADRS_SIZE_BYTES`.
+static inline void th_lanes_prefix(
+    const uint8_t *pk_seed,
+    const hypericum_adrs_batch_t *adrs,
+    uint8_t *in,
+    size_t in_bytes,
+    size_t lanes)
+{
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        uint8_t *lane = in + i * in_bytes;
+        memcpy(lane, pk_seed, HYPERICUM_N_BYTES);
+        memset(
+            lane + HYPERICUM_N_BYTES, 0,
+            HYP_TH_PREFIX_BYTES - HYPERICUM_N_BYTES);
+        hypericum_adrs_batch_write(adrs, i, lane + HYP_TH_PREFIX_BYTES);
+    }
+}
+
+// Hashes the lane inputs laid out by `th_lanes_prefix`, starting from the
+// precomputed prefix state if there is one.
+static inline void th_lanes_hash(
+    const hash_algo_t hash_algo,
+    const uint8_t *pk_seed,
+    hash_function_ctx_t ctx,
+    const uint8_t *in,
+    size_t in_bytes,
+    uint8_t *const *result,
+    size_t lanes)
+{
+    const hash_function_ctx_t prefix = th_prefix_state(hash_algo, pk_seed);
+
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        if (NULL != prefix)
+        {
+            hash_algo->ctx_copy(ctx, prefix);
+            hash_algo->ctx_update(
+                ctx, in + i * in_bytes + HYP_TH_PREFIX_BYTES,
+                in_bytes - HYP_TH_PREFIX_BYTES);
+        }
+        else
+        {
+            hash_algo->ctx_init(ctx);
+            hash_algo->ctx_update(ctx, in + i * in_bytes, in_bytes);
+        }
+        hash_algo->ctx_final(ctx, result[i]);
+    }
+}
+
+// The lanes share one Streebog context. Each lane input is laid out in one
+// buffer, the way a multi-buffer Streebog core takes it; the reference
+// Streebog has none yet, so the buffers are absorbed one after another.
+void hypericum_f_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t *pk_seed,
+    const hypericum_adrs_batch_t *adrs,
+    const uint8_t *const *m,
+    uint8_t *const *result,
+    size_t lanes)
+{
+    const size_t in_bytes = HYP_TH_F_BYTES;
+    uint8_t in[HYPERICUM_HASH_LANES * HYP_TH_F_BYTES];
+
+    th_lanes_prefix(pk_seed, adrs, in, in_bytes, lanes);
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        memcpy(
+            in + i * in_bytes + HYP_TH_PREFIX_BYTES + HYPERICUM_ADRS_SIZE_BYTES,
+            m[i], HYPERICUM_N_BYTES);
+    }
+
+    hash_function_ctx_t ctx = hash_algo->ctx_new();
+
+    th_lanes_hash(hash_algo, pk_seed, ctx, in, in_bytes, result, lanes);
+
+    hash_algo->ctx_free(ctx);
+
+    // chains start from secret values
+    SECURE_ERASE(uint8_t, in, sizeof(in));
+}
+
 void hypericum_h_node(
     const hash_algo_t hash_algo,
     const uint8_t *pk_seed,
@@ -169,6 +454,36 @@ void hypericum_h_node(
         result);
 }
 
+void hypericum_h_node_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t *pk_seed,
+    const hypericum_adrs_batch_t *adrs,
+    const uint8_t *const *left,
+    const uint8_t *const *right,
+    uint8_t *const *result,
+    size_t lanes)
+{
+    const size_t in_bytes = HYP_TH_H_BYTES;
+    uint8_t in[HYPERICUM_HASH_LANES * HYP_TH_H_BYTES];
+
+    // all inputs are read before the first result is written, which lets
+    // results alias the inputs of any lane
+    th_lanes_prefix(pk_seed, adrs, in, in_bytes, lanes);
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        uint8_t *m = in + i * in_bytes + HYP_TH_PREFIX_BYTES +
+                     HYPERICUM_ADRS_SIZE_BYTES;
+        memcpy(m, left[i], HYPERICUM_N_BYTES);
+        memcpy(m + HYPERICUM_N_BYTES, right[i], HYPERICUM_N_BYTES);
+    }
+
+    hash_function_ctx_t ctx = hash_algo->ctx_new();
+
+    th_lanes_hash(hash_algo, pk_seed, ctx, in, in_bytes, result, lanes);
+
+    hash_algo->ctx_free(ctx);
+}
+
 void hypericum_thl(
     const hash_algo_t hash_algo,
     const uint8_t *pk_seed,
@@ -194,35 +509,76 @@ void hypericum_thk(
         result);
 }
 
-// PRF_TLS(rnd, streebog(rnd||pk_seed||pk_root||msg), pk_seed)
-void hypericum_h_msg(
+int hypericum_h_msg_init(
+    hypericum_h_msg_ctx_t *ctx,
     const hash_algo_t hash_algo,
     const uint8_t *rnd,
     const uint8_t *pk_seed,
     const uint8_t *pk_root,
-    const uint8_t *salt,
-    const uint8_t *msg,
-    size_t msg_len,
-    uint8_t *result)
+    const uint8_t *salt)
 {
-    // TODO: pass ctx as a parameter to avoid memory allocation
-    hash_function_ctx_new_t ctx = hash_algo->ctx_new();
+    const size_t n = HYPERICUM_N_BYTES;
 
-    ALLOC_ON_STACK(uint8_t, tmp, hash_algo->output_size);
+    ctx->hash_algo = hash_algo;
+    ctx->ctx = hash_algo->ctx_new();
+    if (NULL == ctx->ctx)
+    {
+        return ENOMEM;
+    }
+    memcpy(ctx->rnd, rnd, n);
+    memcpy(ctx->pk_seed, pk_seed, n);
+
+    hash_algo->ctx_update(ctx->ctx, rnd, n);
+    hash_algo->ctx_update(ctx->ctx, pk_seed, n);
+    hash_algo->ctx_update(ctx->ctx, pk_root, n);
+    hash_algo->ctx_update(ctx->ctx, salt, sizeof(uint32_t));
+    return 0;
+}
+
+void hypericum_h_msg_update(
+    hypericum_h_msg_ctx_t *ctx, const uint8_t *msg, size_t msg_len)
+{
+    ctx->hash_algo->ctx_update(ctx->ctx, msg, msg_len);
+}
 
+// PRF_TLS(rnd, streebog(rnd||pk_seed||pk_root||salt||msg), pk_seed)
+void hypericum_h_msg_final(hypericum_h_msg_ctx_t *ctx, uint8_t *result)
+{
+    const hash_algo_t hash_algo = ctx->hash_algo;
     const size_t n = HYPERICUM_N_BYTES;
 
-    hash_algo->ctx_update(ctx, rnd, n);
-    hash_algo->ctx_update(ctx, pk_seed, n);
-    hash_algo->ctx_update(ctx, pk_root, n);
-    hash_algo->ctx_update(ctx, salt, sizeof(uint32_t));
-    hash_algo->ctx_update(ctx, msg, msg_len);
+    ALLOC_ON_STACK(uint8_t, tmp, hash_algo->output_size);
 
-    hash_algo->ctx_final(ctx, tmp);
-    hash_algo->ctx_free(ctx);
+    hash_algo->ctx_final(ctx->ctx, tmp);
+    hash_algo->ctx_free(ctx->ctx);
+    ctx->ctx = NULL;
 
     prf_tls_gostr3411_2012_256(
-        hash_algo, rnd, n, tmp, hash_algo->output_size, pk_seed, n, 2, result);
+        hash_algo, hmac_key_other, ctx->rnd, n, tmp, hash_algo->output_size, ctx->pk_seed, n,
+        2, result);
+}
+
+int hypericum_h_msg(
+    const hash_algo_t hash_algo,
+    const uint8_t *rnd,
+    const uint8_t *pk_seed,
+    const uint8_t *pk_root,
+    const uint8_t *salt,
+    const uint8_t *msg,
+    size_t msg_len,
+    uint8_t *result)
+{
+    hypericum_h_msg_ctx_t ctx;
+    int ret = hypericum_h_msg_init(
+        &ctx, hash_algo, rnd, pk_seed, pk_root, salt);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    hypericum_h_msg_update(&ctx, msg, msg_len);
+    hypericum_h_msg_final(&ctx, result);
+    return 0;
 }
 
 // PRF_TLS(sk_seed, adrs, pk_seed)
@@ -233,17 +589,74 @@ void hypericum_prf(
     const hypericum_adrs_t *adrs,
     uint8_t *result)
 {
-    uint8_t adrs_bytes[HYPERICUM_ADRS_SIZE_BYTES] = {0};
-    hypericum_adrs_get_bytes(adrs, adrs_bytes);
-
     const size_t n = HYPERICUM_N_BYTES;
     prf_tls_gostr3411_2012_256(
-        hash_algo, sk_seed, n, adrs_bytes, HYPERICUM_ADRS_SIZE_BYTES, pk_seed,
-        n, 1, result);
+        hash_algo, hmac_key_sk_seed, sk_seed, n, hypericum_adrs_bytes(adrs),
+        HYPERICUM_ADRS_SIZE_BYTES, pk_seed, n, 1, result);
+}
+
+void hypericum_prf_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t *sk_seed,
+    const uint8_t *pk_seed,
+    const hypericum_adrs_batch_t *adrs,
+    uint8_t *const *result,
+    size_t lanes)
+{
+    const size_t n = HYPERICUM_N_BYTES;
+    uint8_t adrs_bytes[HYPERICUM_ADRS_SIZE_BYTES];
+
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        hypericum_adrs_batch_write(adrs, i, adrs_bytes);
+        prf_tls_gostr3411_2012_256(
+            hash_algo, hmac_key_sk_seed, sk_seed, n, adrs_bytes, HYPERICUM_ADRS_SIZE_BYTES,
+            pk_seed, n, 1, result[i]);
+    }
+}
+
+int hypericum_prf_msg_init(
+    hypericum_prf_msg_ctx_t *ctx,
+    const hash_algo_t hash_algo,
+    const uint8_t *sk_prf,
+    const uint8_t *pk_seed,
+    const uint8_t *nonce)
+{
+    const size_t n = HYPERICUM_N_BYTES;
+
+    ctx->hash_algo = hash_algo;
+    ctx->ctx = hash_algo->ctx_new();
+    if (NULL == ctx->ctx)
+    {
+        return ENOMEM;
+    }
+    memcpy(ctx->sk_prf, sk_prf, n);
+
+    hmac_init(hash_algo, ctx->ctx, hmac_key_sk_prf, sk_prf, n);
+    hash_algo->ctx_update(ctx->ctx, pk_seed, n);
+    hash_algo->ctx_update(ctx->ctx, nonce, n);
+    return 0;
+}
+
+void hypericum_prf_msg_update(
+    hypericum_prf_msg_ctx_t *ctx, const uint8_t *msg, size_t msg_len)
+{
+    ctx->hash_algo->ctx_update(ctx->ctx, msg, msg_len);
 }
 
 // HMAC(sk_prf, pk_seed || nonce || msg)
-void hypericum_prf_msg(
+void hypericum_prf_msg_final(hypericum_prf_msg_ctx_t *ctx, uint8_t *result)
+{
+    hmac_final(
+        ctx->hash_algo, ctx->ctx, hmac_key_sk_prf, ctx->sk_prf, HYPERICUM_N_BYTES, result);
+    ctx->hash_algo->ctx_free(ctx->ctx);
+    ctx->ctx = NULL;
+    secure_erase(ctx->sk_prf, HYPERICUM_N_BYTES);
+}
+
+// HMAC(sk_prf, pk_seed || nonce || msg), the parts are absorbed one after
+// another without joining them in a buffer
+int hypericum_prf_msg(
     const hash_algo_t hash_algo,
     const uint8_t *sk_prf,
     const uint8_t *pk_seed,
@@ -252,17 +665,16 @@ void hypericum_prf_msg(
     size_t msg_len,
     uint8_t *result)
 {
-    const size_t n = HYPERICUM_N_BYTES;
-    const size_t tmp_len = 2 * n + msg_len;
-    uint8_t *tmp = malloc(tmp_len);
-
-    memcpy(tmp, pk_seed, n);
-    memcpy(tmp + n, nonce, n);
-    memcpy(tmp + 2 * n, msg, msg_len);
-
-    hmac_gostr3411_2012_256(hash_algo, sk_prf, n, tmp, tmp_len, result);
+    hypericum_prf_msg_ctx_t ctx;
+    int ret = hypericum_prf_msg_init(&ctx, hash_algo, sk_prf, pk_seed, nonce);
+    if (ret != 0)
+    {
+        return ret;
+    }
 
-    free(tmp);
+    hypericum_prf_msg_update(&ctx, msg, msg_len);
+    hypericum_prf_msg_final(&ctx, result);
+    return 0;
 }
 
 void hypericum_h_select(
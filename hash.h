@@ -29,8 +29,41 @@
 #include <stddef.h>
 #include <stdint.h>
 
-typedef struct hash_algo_st* hash_algo_t;
-typedef struct _adrs hypericum_adrs_t;
+#include "adrs.h"
+#include "params.h"
+#include "streebog.h"
+
+/* Number of independent messages hashed per call by the *_lanes functions,
+ * one address of a `hypericum_adrs_batch_t` per message. */
+#define HYPERICUM_HASH_LANES HYPERICUM_ADRS_BATCH_LANES
+
+/**
+ * @brief Precomputes the hash states that only depend on the key pair: the
+ * prefix `pk_seed || 0^256` of the tweakable hashes and the HMAC inner and
+ * outer key states of `sk_seed` and `sk_prf`. The tweakable hashes of
+ * `pk_seed`, PRF and PRF_msg start from these states instead of absorbing the
+ * key blocks again. PRF and PRF_msg pick the states of `sk_seed` and `sk_prf`
+ * by role without looking at the keys they are given, so a context with
+ * secret states must only be used with the secret key it was set for.
+ * Replaces the states of a previous key.
+ * @param hash_algo hash context, keeps the states until
+ * `hypericum_hash_clear_keys`. It may be shared by threads afterwards.
+ * @param pk_seed public key seed, length is set by constant
+ * HYPERICUM_N_BYTES.
+ * @param sk_seed secret key seed of length HYPERICUM_N_BYTES or NULL.
+ * @param sk_prf prf secret key of length HYPERICUM_N_BYTES or NULL.
+ * @return 0 on success, ENOMEM, or EINVAL if the hash cannot copy contexts.
+ */
+int hypericum_hash_set_keys(
+    hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    const uint8_t* sk_seed,
+    const uint8_t* sk_prf);
+
+/**
+ * @brief Erases and frees the states of `hypericum_hash_set_keys`.
+ */
+void hypericum_hash_clear_keys(hash_algo_t hash_algo);
 
 /**
  * @brief Computes 256-bit hash with Streebog hash function.
@@ -49,6 +82,27 @@ void hypericum_f(
     const uint8_t* m,
     uint8_t* result);
 
+/**
+ * @brief Computes `hypericum_f` for up to `HYPERICUM_HASH_LANES` independent
+ * inputs at once. Lane `i` hashes `m[i]` under the address of lane `i` into
+ * `result[i]`;
+ * `m[i]` and `result[i]` may point to the same buffer.
+ * @param hash_algo hash context.
+ * @param pk_seed public key seed, length is set by constant
+ * HYPERICUM_N_BYTES.
+ * @param adrs batch of the per-lane hypericum addresses.
+ * @param m per-lane hashable values of size N.
+ * @param [out] result per-lane 256-bit hash results.
+ * @param lanes number of active lanes, at most `HYPERICUM_HASH_LANES`.
+ */
+void hypericum_f_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    const hypericum_adrs_batch_t* adrs,
+    const uint8_t* const* m,
+    uint8_t* const* result,
+    size_t lanes);
+
 /**
  * @brief Computes 256-bit hash with Streebog hash function.
  * Is used to compute nodes in Merkle trees, including FORS.
@@ -68,6 +122,29 @@ void hypericum_h_node(
     const uint8_t* m,
     uint8_t* result);
 
+/**
+ * @brief Computes `hypericum_h_node` for up to `HYPERICUM_HASH_LANES`
+ * independent node pairs at once. Lane `i` hashes `left[i] || right[i]`
+ * under the address of lane `i` into `result[i]`; `result[i]` may alias the
+ * inputs of lane `i` and the inputs of later lanes.
+ * @param hash_algo hash context.
+ * @param pk_seed public key seed, length is set by constant
+ * HYPERICUM_N_BYTES.
+ * @param adrs batch of the per-lane hypericum addresses.
+ * @param left per-lane left child nodes of size N.
+ * @param right per-lane right child nodes of size N.
+ * @param [out] result per-lane 256-bit hash results.
+ * @param lanes number of active lanes, at most `HYPERICUM_HASH_LANES`.
+ */
+void hypericum_h_node_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    const hypericum_adrs_batch_t* adrs,
+    const uint8_t* const* left,
+    const uint8_t* const* right,
+    uint8_t* const* result,
+    size_t lanes);
+
 /**
  * @brief Computes 256-bit hash with Streebog hash function.
  * Is used to compress WOTS+C public key.
@@ -115,8 +192,9 @@ void hypericum_thk(
  * @param msg input message.
  * @param msg_len message length.
  * @param [out] result 512-bit hash result.
+ * @return 0 on success or ENOMEM.
  */
-void hypericum_h_msg(
+int hypericum_h_msg(
     const hash_algo_t hash_algo,
     const uint8_t* rnd,
     const uint8_t* pk_seed,
@@ -126,6 +204,41 @@ void hypericum_h_msg(
     size_t msg_len,
     uint8_t* result);
 
+/**
+ * State of an incremental `hypericum_h_msg`, for messages given in chunks.
+ */
+typedef struct hypericum_h_msg_ctx_st
+{
+    hash_algo_t hash_algo;
+    hash_function_ctx_t ctx;
+    uint8_t rnd[HYPERICUM_N_BYTES];
+    uint8_t pk_seed[HYPERICUM_N_BYTES];
+} hypericum_h_msg_ctx_t;
+
+/**
+ * @brief Starts `hypericum_h_msg`, the parameters are those of
+ * `hypericum_h_msg` without the message.
+ * @return 0 on success or ENOMEM.
+ */
+int hypericum_h_msg_init(
+    hypericum_h_msg_ctx_t* ctx,
+    const hash_algo_t hash_algo,
+    const uint8_t* rnd,
+    const uint8_t* pk_seed,
+    const uint8_t* pk_root,
+    const uint8_t* salt);
+
+/**
+ * @brief Absorbs the next chunk of the message.
+ */
+void hypericum_h_msg_update(
+    hypericum_h_msg_ctx_t* ctx, const uint8_t* msg, size_t msg_len);
+
+/**
+ * @brief Computes the 512-bit result and releases the state.
+ */
+void hypericum_h_msg_final(hypericum_h_msg_ctx_t* ctx, uint8_t* result);
+
 /**
  * @brief Pseudo-randomly generate secret key elements from a secret seed.
  * @param hash_algo hash context.
@@ -143,6 +256,26 @@ void hypericum_prf(
     const hypericum_adrs_t* adrs,
     uint8_t* result);
 
+/**
+ * @brief Computes `hypericum_prf` for up to `HYPERICUM_HASH_LANES` addresses
+ * at once.
+ * @param hash_algo hash context.
+ * @param sk_seed secret key seed, length is set by constant
+ * HYPERICUM_N_BYTES.
+ * @param pk_seed public key seed, length is set by constant
+ * HYPERICUM_N_BYTES.
+ * @param adrs batch of the per-lane hypericum addresses.
+ * @param [out] result per-lane 256-bit hash results.
+ * @param lanes number of active lanes, at most `HYPERICUM_HASH_LANES`.
+ */
+void hypericum_prf_lanes(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    const hypericum_adrs_batch_t* adrs,
+    uint8_t* const* result,
+    size_t lanes);
+
 /**
  * @brief Generate a pseudo-random value used during original message
  * compression.
@@ -156,8 +289,9 @@ void hypericum_prf(
  * @param msg input message.
  * @param msg_len message length.
  * @param [out] result 256-bit hash result.
+ * @return 0 on success or ENOMEM.
  */
-void hypericum_prf_msg(
+int hypericum_prf_msg(
     const hash_algo_t hash_algo,
     const uint8_t* sk_prf,
     const uint8_t* pk_seed,
@@ -166,6 +300,40 @@ void hypericum_prf_msg(
     size_t msg_len,
     uint8_t* result);
 
+/**
+ * State of an incremental `hypericum_prf_msg`, for messages given in chunks.
+ */
+typedef struct hypericum_prf_msg_ctx_st
+{
+    hash_algo_t hash_algo;
+    hash_function_ctx_t ctx;
+    uint8_t sk_prf[HYPERICUM_N_BYTES];
+} hypericum_prf_msg_ctx_t;
+
+/**
+ * @brief Starts `hypericum_prf_msg`, the parameters are those of
+ * `hypericum_prf_msg` without the message.
+ * @return 0 on success or ENOMEM.
+ */
+int hypericum_prf_msg_init(
+    hypericum_prf_msg_ctx_t* ctx,
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_prf,
+    const uint8_t* pk_seed,
+    const uint8_t* nonce);
+
+/**
+ * @brief Absorbs the next chunk of the message.
+ */
+void hypericum_prf_msg_update(
+    hypericum_prf_msg_ctx_t* ctx, const uint8_t* msg, size_t msg_len);
+
+/**
+ * @brief Computes the 256-bit result and releases the state, the copy of
+ * the key is erased.
+ */
+void hypericum_prf_msg_final(hypericum_prf_msg_ctx_t* ctx, uint8_t* result);
+
 /**
  * @brief Computes 256-bit hash with Streebog hash function.
  * Is used for selecting WOTS+C hash values.
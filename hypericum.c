@@ -43,12 +43,9 @@ int crypto_sign(
     unsigned long long mlen,
     const unsigned char* sk)
 {
-    unsigned long long i;
-    for (i = mlen; i > 0; i--) {
-        sm[HYP_SIGNATURE_BYTES + i - 1] = m[i - 1];
-    }
+    memmove(sm + HYP_SIGNATURE_BYTES, m, mlen);
     *smlen = HYP_SIGNATURE_BYTES + mlen;
-    return hypericum_sign(sk, m, mlen, sm);
+    return hypericum_sign_detached(sm, sm + HYP_SIGNATURE_BYTES, mlen, sk);
 }
 
 int crypto_sign_open(
@@ -58,8 +55,54 @@ int crypto_sign_open(
     unsigned long long smlen,
     const unsigned char* pk)
 {
+    if (smlen < HYP_SIGNATURE_BYTES) {
+        *mlen = 0;
+        return HYPERICUM_REJECT_LENGTH;
+    }
     *mlen = smlen - HYP_SIGNATURE_BYTES;
 
-    memcpy(m, sm + HYP_SIGNATURE_BYTES, *mlen);
-    return hypericum_verify(pk, sm, m, *mlen);
+    // the message is verified in place and only copied out when valid
+    int ret = hypericum_verify_detached(sm, sm + HYP_SIGNATURE_BYTES, *mlen, pk);
+    if (ret == 0) {
+        memmove(m, sm + HYP_SIGNATURE_BYTES, *mlen);
+    }
+    return ret;
+}
+
+int hypericum_sign_detached(
+    unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* sk)
+{
+    return hypericum_sign(sk, m, mlen, sig);
+}
+
+int hypericum_sign_detached_timed(
+    unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* sk,
+    hypericum_timings_t* timings)
+{
+    return hypericum_sign_timed(sk, m, mlen, timings, sig);
+}
+
+int hypericum_verify_detached(
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* pk)
+{
+    return hypericum_verify(pk, sig, m, mlen);
+}
+
+int hypericum_verify_detached_timed(
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* pk,
+    hypericum_timings_t* timings)
+{
+    return hypericum_verify_timed(pk, sig, m, mlen, timings);
 }
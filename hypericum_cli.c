@@ -0,0 +1,560 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Command line tool to generate keys and to sign and verify files with
+// detached signatures. Files are mapped into memory where possible and
+// streamed in chunks otherwise, they are never loaded into heap buffers.
+
+#include "api.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else  // WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // WIN32
+
+// Size of the chunks a file is streamed in
+#define CHUNK_BYTES (1u << 20)
+// Size of a new cache file
+#define CACHE_BYTES ((size_t)64 << 20)
+#define CACHE_MAX_SUBTREES 4096
+
+struct options
+{
+    unsigned threads;
+    int timings;
+    int prehashed;
+    const char* cache_path;
+};
+
+// Message file mapped into memory
+struct mapping
+{
+    const unsigned char* data;
+    size_t len;
+};
+
+static void usage()
+{
+    fprintf(
+        stderr,
+        "usage: hypericum [options] keygen [-x] SK_FILE PK_FILE\n"
+        "       hypericum [options] sign SK_FILE FILE SIG_FILE\n"
+        "       hypericum [options] verify PK_FILE FILE SIG_FILE\n"
+        "\n"
+        "FILE may be - for the standard input.\n"
+        "\n"
+        "options:\n"
+        "  -c CACHE  keep XMSS subtrees in the file CACHE between runs of sign\n"
+        "            for the same key, not with -p\n"
+        "  -j N      sign with N threads\n"
+        "  -p        pre-hash mode: sign the Streebog-256 hash of FILE, which\n"
+        "            is streamed, or verify such a signature. Needed to sign\n"
+        "            a FILE that can't be mapped, such as a pipe. A pre-hash\n"
+        "            signature differs from a plain one and verifies only\n"
+        "            with -p\n"
+        "  -t        print the duration of each phase to the standard error\n"
+        "\n"
+        "keygen -x writes an extended secret key holding the top layer XMSS\n"
+        "tree, which sign reads instead of building it every time.\n");
+}
+
+// Number of XMSS subtrees of a new cache file: as many as fit in
+// CACHE_BYTES, but at least one per hypertree layer and at most
+// CACHE_MAX_SUBTREES, as every lookup scans the entries.
+static size_t cache_subtrees()
+{
+    size_t subtrees = CACHE_BYTES / HYP_TOP_TREE_BYTES;
+    if (subtrees < HYP_D) {
+        subtrees = HYP_D;
+    }
+    if (subtrees > CACHE_MAX_SUBTREES) {
+        subtrees = CACHE_MAX_SUBTREES;
+    }
+    return subtrees;
+}
+
+static const char* reject_reason(int ret)
+{
+    switch (ret) {
+        case HYPERICUM_REJECT_LENGTH:
+            return "wrong length";
+        case HYPERICUM_REJECT_DIGEST:
+            return "message digest";
+        case HYPERICUM_REJECT_WOTS:
+            return "WOTS+C checksum";
+        case HYPERICUM_REJECT_ROOT:
+            return "hypertree root";
+        default:
+            return "unknown reason";
+    }
+}
+
+static void print_phase(const char* name, uint64_t ns)
+{
+    fprintf(stderr, "%-14s %12.3f ms\n", name, ns / 1e6);
+}
+
+// Prints the phases of signing (`grind` set) or verification. `read_ns` is
+// the time spent on reading a streamed file, which counts as hashing.
+static void print_timings(
+    const hypericum_timings_t* timings, uint64_t read_ns, int grind)
+{
+    print_phase("message hash", read_ns + timings->msg_hash_ns);
+    if (grind) {
+        print_phase("nonce grind", timings->grind_ns);
+        fprintf(stderr, "%-14s %12u\n", "candidates", timings->grind_iterations);
+    }
+    print_phase("FORS+C", timings->fors_ns);
+    print_phase("hypertree", timings->hypertree_ns);
+    print_phase(
+        "total", read_ns + timings->msg_hash_ns + timings->grind_ns +
+                     timings->fors_ns + timings->hypertree_ns);
+}
+
+// Reads a file of exactly `len` bytes.
+static int read_exact(const char* path, unsigned char* buf, size_t len)
+{
+    FILE* f = fopen(path, "rb");
+    if (NULL == f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t got = fread(buf, 1, len, f);
+    int extra = fgetc(f) != EOF;
+    fclose(f);
+
+    if (got != len || extra) {
+        fprintf(stderr, "%s: expected %zu bytes\n", path, len);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads a secret key, either a plain or an extended one.
+static unsigned char* read_key(const char* path, size_t* len)
+{
+    FILE* f = fopen(path, "rb");
+    if (NULL == f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    unsigned char* sk = (unsigned char*)malloc(HYP_SECRET_KEY_EXT_BYTES + 1);
+    *len = NULL == sk ? 0 : fread(sk, 1, HYP_SECRET_KEY_EXT_BYTES + 1, f);
+    fclose(f);
+
+    if (*len != CRYPTO_SECRETKEYBYTES && *len != HYP_SECRET_KEY_EXT_BYTES) {
+        fprintf(stderr, "%s: not a secret key\n", path);
+        if (NULL != sk) {
+            memset(sk, 0, HYP_SECRET_KEY_EXT_BYTES + 1);
+        }
+        free(sk);
+        return NULL;
+    }
+    return sk;
+}
+
+// Writes a file, secret ones are only readable by the owner.
+static int write_file(
+    const char* path, const unsigned char* buf, size_t len, int secret)
+{
+#ifdef WIN32
+    (void)secret;
+    FILE* f = fopen(path, "wb");
+#else   // WIN32
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, secret ? 0600 : 0644);
+    FILE* f = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (NULL == f && fd >= 0) {
+        close(fd);
+    }
+#endif  // WIN32
+    if (NULL == f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ok = fwrite(buf, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "%s: write failed\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Maps a regular file read-only. Returns nonzero if the file can only be
+// streamed: the standard input, pipes and devices, or any system without
+// mmap.
+static int map_file(const char* path, struct mapping* map)
+{
+#ifdef WIN32
+    (void)path;
+    (void)map;
+    return ENOSYS;
+#else   // WIN32
+    if (strcmp(path, "-") == 0) {
+        return ESPIPE;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return ESPIPE;
+    }
+
+    map->len = (size_t)st.st_size;
+    if (map->len == 0) {
+        // an empty file cannot be mapped
+        map->data = (const unsigned char*)"";
+        close(fd);
+        return 0;
+    }
+
+    void* data = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == data) {
+        return errno;
+    }
+    madvise(data, map->len, MADV_SEQUENTIAL);
+
+    map->data = (const unsigned char*)data;
+    return 0;
+#endif  // WIN32
+}
+
+static void unmap_file(struct mapping* map)
+{
+#ifndef WIN32
+    if (map->len > 0) {
+        munmap((void*)map->data, map->len);
+    }
+#endif  // WIN32
+}
+
+typedef void (*stream_update_t)(
+    void* stream, const unsigned char* data, size_t len);
+
+static void sign_stream_update(
+    void* stream, const unsigned char* data, size_t len)
+{
+    hypericum_sign_stream_update((hypericum_sign_stream_t*)stream, data, len);
+}
+
+static void verify_stream_update(
+    void* stream, const unsigned char* data, size_t len)
+{
+    hypericum_verify_stream_update(
+        (hypericum_verify_stream_t*)stream, data, len);
+}
+
+// Feeds the file to `update`, straight from its mapping if it has one,
+// otherwise in chunks.
+static int feed_file(const char* path, stream_update_t update, void* stream)
+{
+    struct mapping map;
+    if (map_file(path, &map) == 0) {
+        update(stream, map.data, map.len);
+        unmap_file(&map);
+        return 0;
+    }
+
+    FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (NULL == f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ret = 0;
+    unsigned char* chunk = (unsigned char*)malloc(CHUNK_BYTES);
+    if (NULL == chunk) {
+        fprintf(stderr, "out of memory\n");
+        ret = -1;
+    }
+    while (0 == ret) {
+        size_t got = fread(chunk, 1, CHUNK_BYTES, f);
+        if (got > 0) {
+            update(stream, chunk, got);
+        }
+        if (got < CHUNK_BYTES) {
+            if (ferror(f)) {
+                fprintf(stderr, "%s: read failed: %s\n", path, strerror(errno));
+                ret = -1;
+            }
+            break;
+        }
+    }
+
+    free(chunk);
+    if (f != stdin) {
+        fclose(f);
+    }
+    return ret;
+}
+
+static int keygen(int extended, const char* sk_path, const char* pk_path)
+{
+    const size_t sk_len =
+        extended ? HYP_SECRET_KEY_EXT_BYTES : CRYPTO_SECRETKEYBYTES;
+    unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+    unsigned char* sk = (unsigned char*)malloc(sk_len);
+    if (NULL == sk) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    int ret = extended ? hypericum_generate_keys_ext(sk, pk)
+                       : crypto_sign_keypair(pk, sk);
+    if (ret != 0) {
+        fprintf(stderr, "key generation failed: %d\n", ret);
+    } else if (
+        write_file(sk_path, sk, sk_len, 1) != 0 ||
+        write_file(pk_path, pk, sizeof(pk), 0) != 0) {
+        ret = -1;
+    }
+
+    memset(sk, 0, sk_len);
+    free(sk);
+    return ret;
+}
+
+static int sign(
+    const struct options* opts,
+    const char* sk_path,
+    const char* path,
+    const char* sig_path)
+{
+    size_t sk_len = 0;
+    unsigned char* sk = read_key(sk_path, &sk_len);
+    if (NULL == sk) {
+        return -1;
+    }
+
+    unsigned char* sig = (unsigned char*)malloc(CRYPTO_BYTES);
+    if (NULL == sig) {
+        fprintf(stderr, "out of memory\n");
+        memset(sk, 0, sk_len);
+        free(sk);
+        return -1;
+    }
+
+    hypericum_timings_t timings;
+    uint64_t read_ns = 0;
+    int ret = 0;
+
+    if (opts->prehashed) {
+        hypericum_sign_stream_t* stream = NULL;
+        if ((ret = hypericum_sign_stream_new(sk, &stream)) == 0) {
+            uint64_t start = hypericum_time_ns();
+            ret = feed_file(path, sign_stream_update, stream);
+            read_ns = hypericum_time_ns() - start;
+            if (ret == 0) {
+                ret = hypericum_sign_stream_final_timed(stream, sig, &timings);
+            }
+            hypericum_sign_stream_free(stream);
+        }
+    } else {
+        struct mapping map;
+        int err = map_file(path, &map);
+        if (err != 0) {
+            fprintf(
+                stderr,
+                "%s: cannot be mapped (%s), use -p to sign a pre-hash of "
+                "the stream,\nwhich gives a different signature that "
+                "verifies only with -p\n",
+                path, strerror(err));
+            ret = -1;
+        } else if (
+            NULL != opts->cache_path || sk_len != CRYPTO_SECRETKEYBYTES) {
+            // a signer reads the tree of an extended key and the cache file
+            hypericum_signer_t* signer = NULL;
+            ret = NULL != opts->cache_path
+                      ? hypericum_signer_new_file_cache(
+                            sk, sk_len, cache_subtrees(), opts->cache_path,
+                            &signer)
+                      : hypericum_signer_new(sk, sk_len, 0, &signer);
+            if (ret == 0) {
+                ret = hypericum_signer_sign_timed(
+                    signer, map.data, map.len, sig, &timings);
+                hypericum_signer_free(signer);
+            } else {
+                fprintf(
+                    stderr, "cannot prepare signing with %s: %s\n", sk_path,
+                    strerror(ret));
+                ret = -1;
+            }
+            unmap_file(&map);
+        } else {
+            ret = hypericum_sign_detached_timed(
+                sig, map.data, map.len, sk, &timings);
+            unmap_file(&map);
+        }
+    }
+    memset(sk, 0, sk_len);
+    free(sk);
+
+    if (ret == 0) {
+        ret = write_file(sig_path, sig, CRYPTO_BYTES, 0);
+        if (ret == 0 && opts->timings) {
+            print_timings(&timings, read_ns, 1);
+        }
+    } else if (ret > 0) {
+        fprintf(stderr, "signing failed: %s\n", strerror(ret));
+    }
+
+    free(sig);
+    return ret;
+}
+
+static int verify(
+    const struct options* opts,
+    const char* pk_path,
+    const char* path,
+    const char* sig_path)
+{
+    unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+    if (read_exact(pk_path, pk, sizeof(pk)) != 0) {
+        return -1;
+    }
+
+    unsigned char* sig = (unsigned char*)malloc(CRYPTO_BYTES);
+    if (NULL == sig) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    if (read_exact(sig_path, sig, CRYPTO_BYTES) != 0) {
+        free(sig);
+        return -1;
+    }
+
+    hypericum_timings_t timings;
+    uint64_t read_ns = 0;
+    int ret = 0;
+    struct mapping map;
+
+    if (!opts->prehashed && map_file(path, &map) == 0) {
+        ret = hypericum_verify_detached_timed(
+            sig, map.data, map.len, pk, &timings);
+        unmap_file(&map);
+    } else {
+        hypericum_verify_stream_t* stream = NULL;
+        if ((ret = hypericum_verify_stream_new(
+                 sig, pk, opts->prehashed, &stream)) == 0) {
+            uint64_t start = hypericum_time_ns();
+            ret = feed_file(path, verify_stream_update, stream);
+            read_ns = hypericum_time_ns() - start;
+            if (ret == 0) {
+                ret = hypericum_verify_stream_final_timed(stream, &timings);
+            }
+            hypericum_verify_stream_free(stream);
+        }
+    }
+    free(sig);
+
+    // only a reject code makes a signature invalid, errors of reading the
+    // file (-1, already reported) or of verification are no verdict
+    const int rejected = ret >= HYPERICUM_REJECT_LENGTH;
+    if (ret == 0) {
+        printf("%s: signature is valid\n", path);
+    } else if (rejected) {
+        printf("%s: signature is invalid (%s)\n", path, reject_reason(ret));
+    } else if (ret > 0) {
+        fprintf(stderr, "%s: verification failed: %s\n", path, strerror(ret));
+    }
+    if (opts->timings && (ret == 0 || rejected)) {
+        print_timings(&timings, read_ns, 0);
+    }
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    struct options opts = {
+        .threads = 1, .timings = 0, .prehashed = 0, .cache_path = NULL};
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            opts.cache_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            opts.threads = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            opts.prehashed = 1;
+        } else if (strcmp(argv[i], "-t") == 0) {
+            opts.timings = 1;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (opts.prehashed && NULL != opts.cache_path) {
+        usage();
+        return 2;
+    }
+
+    if (opts.threads != 1) {
+        int err = hypericum_set_threads(opts.threads);
+        if (err != 0) {
+            fprintf(stderr, "cannot use %u threads: %s\n", opts.threads,
+                    strerror(err));
+            return 2;
+        }
+    }
+
+    const int args = argc - i;
+    int ret;
+    if (args == 3 && strcmp(argv[i], "keygen") == 0) {
+        ret = keygen(0, argv[i + 1], argv[i + 2]);
+    } else if (
+        args == 4 && strcmp(argv[i], "keygen") == 0 &&
+        strcmp(argv[i + 1], "-x") == 0) {
+        ret = keygen(1, argv[i + 2], argv[i + 3]);
+    } else if (args == 4 && strcmp(argv[i], "sign") == 0) {
+        ret = sign(&opts, argv[i + 1], argv[i + 2], argv[i + 3]);
+    } else if (args == 4 && strcmp(argv[i], "verify") == 0) {
+        ret = verify(&opts, argv[i + 1], argv[i + 2], argv[i + 3]);
+    } else {
+        usage();
+        return 2;
+    }
+
+    return ret == 0 ? 0 : 1;
+}
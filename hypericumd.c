@@ -0,0 +1,791 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Signing daemon: holds one secret key and serves signing and verification
+// requests of local clients over a Unix domain socket.
+//
+// Requests and responses are frames of an 8 byte header and a payload:
+//
+//   byte 0      request type or response status
+//   bytes 1-3   zero
+//   bytes 4-7   payload length, big endian
+//
+// Request types:
+//   1 sign      payload: message; response payload: signature of
+//               CRYPTO_BYTES bytes
+//   2 verify    payload: signature of CRYPTO_BYTES bytes followed by the
+//               message, under the key of the daemon; empty response
+//   3 stats     empty payload; response payload: the counters below as big
+//               endian 64-bit integers
+//   4 pubkey    empty payload; response payload: public key
+//
+// Response status: 0 success, 1 invalid signature, 2 malformed request,
+// 3 internal error. A malformed request also closes the connection.
+// Responses of a connection come in the order of its requests, which may be
+// pipelined.
+//
+// Requests that arrive while a batch is being served are read together and
+// served as the next batch: signatures by `hypericum_signer_sign_batch`,
+// which builds subtrees shared by the messages once and keeps them in the
+// subtree cache like single signatures do, so that a batch of one request
+// costs no more than a cached signature, and verifications by
+// `hypericum_verify_batch`.
+
+#include "api.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif  // __linux__
+
+#define FRAME_HEADER_BYTES 8
+// Bytes of responses queued for a connection above which its requests are
+// no longer read nor served, until the client reads the responses
+#define MAX_OUT_BYTES (4u << 20)
+// Memory of the subtree cache by default
+#define CACHE_BYTES ((size_t)64 << 20)
+#define CACHE_MAX_SUBTREES 4096
+
+enum request_type
+{
+    request_sign = 1,
+    request_verify = 2,
+    request_stats = 3,
+    request_pubkey = 4,
+};
+
+enum response_status
+{
+    status_ok = 0,
+    status_invalid = 1,
+    status_malformed = 2,
+    status_error = 3,
+};
+
+// Counters of the daemon, in the order of a stats response
+struct counters
+{
+    uint64_t connections;
+    uint64_t sign_requests;
+    uint64_t verify_requests;
+    uint64_t invalid_signatures;
+    uint64_t errors;
+    uint64_t batches;
+    // largest number of requests served by one batch
+    uint64_t max_batch;
+    // time spent serving batches
+    uint64_t busy_ns;
+    // time from a complete request to its response, summed and at most
+    uint64_t latency_ns;
+    uint64_t max_latency_ns;
+};
+
+#define COUNTERS_COUNT (sizeof(struct counters) / sizeof(uint64_t))
+
+struct options
+{
+    unsigned threads;
+    size_t cache_subtrees;
+    const char* cache_path;
+    size_t max_batch;
+    size_t max_message;
+};
+
+// Connection of a client, with the bytes read and not yet parsed and the
+// bytes of responses not yet written.
+struct conn
+{
+    int fd;
+    // the client sent everything, or the connection is dropped after a
+    // malformed request or an error
+    int eof;
+    int closing;
+    unsigned char* in;
+    size_t in_len;
+    size_t in_cap;
+    unsigned char* out;
+    size_t out_len;
+    size_t out_cap;
+};
+
+// A request of the current batch.
+struct request
+{
+    struct conn* conn;
+    uint8_t type;
+    unsigned char* payload;
+    size_t len;
+    uint64_t received_ns;
+    uint8_t status;
+    // signature made for a sign request
+    unsigned char* sig;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int signo)
+{
+    (void)signo;
+    stopping = 1;
+}
+
+// Number of XMSS subtrees cached by default: as many as fit in CACHE_BYTES,
+// whose subtrees take from a few hundred bytes to megabytes each depending
+// on the parameter set, but at least one per hypertree layer and at most
+// CACHE_MAX_SUBTREES, as every lookup scans the entries.
+static size_t default_cache_subtrees()
+{
+    size_t subtrees = CACHE_BYTES / HYP_TOP_TREE_BYTES;
+    if (subtrees < HYP_D) {
+        subtrees = HYP_D;
+    }
+    if (subtrees > CACHE_MAX_SUBTREES) {
+        subtrees = CACHE_MAX_SUBTREES;
+    }
+    return subtrees;
+}
+
+static void usage()
+{
+    fprintf(
+        stderr,
+        "usage: hypericumd [options] SK_FILE SOCKET\n"
+        "\n"
+        "options:\n"
+        "  -j N     sign with N threads\n"
+        "  -c N     keep N XMSS subtrees cached, default %zu (%zu KiB)\n"
+        "  -f FILE  keep the cached subtrees in FILE, which outlives the\n"
+        "           daemon and may be shared by several of them\n"
+        "  -b N     serve at most N requests per batch, default 256\n"
+        "  -m N     accept messages of at most N bytes, default 1048576\n",
+        default_cache_subtrees(),
+        default_cache_subtrees() * HYP_TOP_TREE_BYTES >> 10);
+}
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+// Grows `*buf` of capacity `*cap` to hold at least `len` bytes.
+static int reserve(unsigned char** buf, size_t* cap, size_t len)
+{
+    if (len <= *cap) {
+        return 0;
+    }
+    size_t new_cap = *cap > 0 ? *cap : 4096;
+    while (new_cap < len) {
+        new_cap *= 2;
+    }
+    unsigned char* p = (unsigned char*)realloc(*buf, new_cap);
+    if (NULL == p) {
+        return ENOMEM;
+    }
+    *buf = p;
+    *cap = new_cap;
+    return 0;
+}
+
+static int queue_response(
+    struct conn* conn, uint8_t status, const unsigned char* payload,
+    size_t len)
+{
+    if (reserve(&conn->out, &conn->out_cap,
+                conn->out_len + FRAME_HEADER_BYTES + len) != 0) {
+        return ENOMEM;
+    }
+    unsigned char* p = conn->out + conn->out_len;
+    memset(p, 0, FRAME_HEADER_BYTES);
+    p[0] = status;
+    put_u32(p + 4, (uint32_t)len);
+    if (len > 0) {
+        memcpy(p + FRAME_HEADER_BYTES, payload, len);
+    }
+    conn->out_len += FRAME_HEADER_BYTES + len;
+    return 0;
+}
+
+// Reads the secret key, either a plain or an extended one.
+static unsigned char* read_key(const char* path, size_t* len)
+{
+    FILE* f = fopen(path, "rb");
+    if (NULL == f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    unsigned char* sk = (unsigned char*)malloc(HYP_SECRET_KEY_EXT_BYTES + 1);
+    *len = NULL == sk ? 0 : fread(sk, 1, HYP_SECRET_KEY_EXT_BYTES + 1, f);
+    fclose(f);
+
+    if (*len != HYP_SECRET_KEY_BYTES && *len != HYP_SECRET_KEY_EXT_BYTES) {
+        fprintf(stderr, "%s: not a secret key\n", path);
+        if (NULL != sk) {
+            memset(sk, 0, HYP_SECRET_KEY_EXT_BYTES + 1);
+        }
+        free(sk);
+        return NULL;
+    }
+    return sk;
+}
+
+static int listen_on(const char* path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: path too long\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // only the owner of the daemon may connect
+    unlink(path);
+    mode_t mask = umask(0077);
+    int ret = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(mask);
+    if (ret != 0 || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void close_conn(struct conn* conn)
+{
+    close(conn->fd);
+    free(conn->in);
+    free(conn->out);
+    memset(conn, 0, sizeof(struct conn));
+    conn->fd = -1;
+}
+
+// Parses the complete frames read from `conn` into requests, at most up to
+// `max` of them. Returns the number of requests added.
+static size_t parse_requests(
+    const struct options* opts,
+    struct conn* conn,
+    struct request* requests,
+    size_t max)
+{
+    size_t count = 0, pos = 0;
+    const uint64_t now = hypericum_time_ns();
+
+    while (count < max && !conn->closing &&
+           conn->in_len - pos >= FRAME_HEADER_BYTES) {
+        const unsigned char* header = conn->in + pos;
+        const size_t len = get_u32(header + 4);
+
+        int valid = header[1] == 0 && header[2] == 0 && header[3] == 0;
+        switch (header[0]) {
+            case request_sign:
+                valid = valid && len <= opts->max_message;
+                break;
+            case request_verify:
+                valid = valid && len >= CRYPTO_BYTES &&
+                        len - CRYPTO_BYTES <= opts->max_message;
+                break;
+            case request_stats:
+            case request_pubkey:
+                valid = valid && len == 0;
+                break;
+            default:
+                valid = 0;
+        }
+        struct request* request = &requests[count];
+        memset(request, 0, sizeof(struct request));
+        request->conn = conn;
+        request->received_ns = now;
+        if (!valid) {
+            // answered in turn with the requests before it
+            conn->closing = 1;
+            count++;
+            break;
+        }
+        if (conn->in_len - pos - FRAME_HEADER_BYTES < len) {
+            break;
+        }
+
+        request->type = header[0];
+        request->len = len;
+        // a failed copy is answered with an error
+        request->payload = (unsigned char*)malloc(len > 0 ? len : 1);
+        if (NULL != request->payload) {
+            memcpy(request->payload, header + FRAME_HEADER_BYTES, len);
+        }
+        count++;
+        pos += FRAME_HEADER_BYTES + len;
+    }
+
+    if (conn->closing) {
+        conn->in_len = 0;
+    } else {
+        memmove(conn->in, conn->in + pos, conn->in_len - pos);
+        conn->in_len -= pos;
+    }
+    return count;
+}
+
+// Serves a batch of requests and queues their responses in order.
+static void serve_batch(
+    hypericum_signer_t* signer,
+    const unsigned char* pk,
+    struct counters* counters,
+    struct request* requests,
+    size_t count)
+{
+    const uint64_t start = hypericum_time_ns();
+
+    const unsigned char** msgs =
+        (const unsigned char**)malloc(count * sizeof(unsigned char*));
+    const unsigned char** sigs =
+        (const unsigned char**)malloc(count * sizeof(unsigned char*));
+    const unsigned char** pks =
+        (const unsigned char**)malloc(count * sizeof(unsigned char*));
+    unsigned char** out_sigs =
+        (unsigned char**)malloc(count * sizeof(unsigned char*));
+    size_t* lens = (size_t*)malloc(count * sizeof(size_t));
+    int* results = (int*)malloc(count * sizeof(int));
+    struct request** batch =
+        (struct request**)malloc(count * sizeof(struct request*));
+    const int ready = NULL != msgs && NULL != sigs && NULL != pks &&
+                      NULL != out_sigs && NULL != lens && NULL != results &&
+                      NULL != batch;
+
+    for (size_t i = 0; i < count; i++) {
+        requests[i].status = status_error;
+        if (requests[i].type == request_sign && NULL != requests[i].payload) {
+            requests[i].sig = (unsigned char*)malloc(CRYPTO_BYTES);
+        }
+    }
+
+    // signatures
+    size_t n = 0;
+    for (size_t i = 0; ready && i < count; i++) {
+        struct request* request = &requests[i];
+        if (request->type == request_sign && NULL != request->sig) {
+            batch[n] = request;
+            msgs[n] = request->payload;
+            lens[n] = request->len;
+            out_sigs[n] = request->sig;
+            n++;
+        }
+    }
+    if (n > 0 && hypericum_signer_sign_batch(
+                     signer, msgs, lens, n, out_sigs) == 0) {
+        for (size_t i = 0; i < n; i++) {
+            batch[i]->status = status_ok;
+        }
+    }
+
+    // verifications
+    n = 0;
+    for (size_t i = 0; ready && i < count; i++) {
+        struct request* request = &requests[i];
+        if (request->type == request_verify && NULL != request->payload) {
+            batch[n] = request;
+            pks[n] = pk;
+            sigs[n] = request->payload;
+            msgs[n] = request->payload + CRYPTO_BYTES;
+            lens[n] = request->len - CRYPTO_BYTES;
+            n++;
+        }
+    }
+    if (n > 0) {
+        hypericum_verify_batch(pks, msgs, lens, sigs, n, results);
+        // a signature is invalid only if it was rejected, a verification
+        // that failed otherwise is an error
+        for (size_t i = 0; i < n; i++) {
+            batch[i]->status =
+                results[i] == 0 ? status_ok
+                : results[i] >= HYPERICUM_REJECT_LENGTH ? status_invalid
+                                                        : status_error;
+            counters->invalid_signatures +=
+                batch[i]->status == status_invalid;
+        }
+    }
+
+    const uint64_t end = hypericum_time_ns();
+    counters->batches++;
+    if (count > counters->max_batch) {
+        counters->max_batch = count;
+    }
+    counters->busy_ns += end - start;
+
+    for (size_t i = 0; i < count; i++) {
+        struct request* request = &requests[i];
+        unsigned char stats[COUNTERS_COUNT * 8];
+
+        const unsigned char* payload = NULL;
+        size_t len = 0;
+        switch (request->type) {
+            case request_sign:
+                counters->sign_requests++;
+                if (request->status == status_ok) {
+                    payload = request->sig;
+                    len = CRYPTO_BYTES;
+                }
+                break;
+            case request_verify:
+                counters->verify_requests++;
+                break;
+            case request_stats: {
+                const uint64_t* values = (const uint64_t*)counters;
+                for (size_t k = 0; k < COUNTERS_COUNT; k++) {
+                    put_u32(stats + 8 * k, (uint32_t)(values[k] >> 32));
+                    put_u32(stats + 8 * k + 4, (uint32_t)values[k]);
+                }
+                request->status = status_ok;
+                payload = stats;
+                len = sizeof(stats);
+                break;
+            }
+            case request_pubkey:
+                request->status = status_ok;
+                payload = pk;
+                len = CRYPTO_PUBLICKEYBYTES;
+                break;
+            default:
+                request->status = status_malformed;
+                break;
+        }
+        counters->errors += request->status != status_ok &&
+                            request->status != status_invalid;
+
+        if (queue_response(request->conn, request->status, payload, len) !=
+            0) {
+            request->conn->closing = 1;
+        }
+
+        const uint64_t latency = end - request->received_ns;
+        counters->latency_ns += latency;
+        if (latency > counters->max_latency_ns) {
+            counters->max_latency_ns = latency;
+        }
+
+        free(request->sig);
+        free(request->payload);
+    }
+
+    free(batch);
+    free(results);
+    free(lens);
+    free(out_sigs);
+    free(pks);
+    free(sigs);
+    free(msgs);
+}
+
+static void print_counters(const struct counters* counters)
+{
+    const uint64_t requests =
+        counters->sign_requests + counters->verify_requests;
+    fprintf(
+        stderr,
+        "connections %llu, signed %llu, verified %llu (%llu invalid), "
+        "errors %llu\n"
+        "batches %llu (at most %llu requests), busy %.3f s, "
+        "latency %.3f ms on average, %.3f ms at most\n",
+        (unsigned long long)counters->connections,
+        (unsigned long long)counters->sign_requests,
+        (unsigned long long)counters->verify_requests,
+        (unsigned long long)counters->invalid_signatures,
+        (unsigned long long)counters->errors,
+        (unsigned long long)counters->batches,
+        (unsigned long long)counters->max_batch, counters->busy_ns / 1e9,
+        requests > 0 ? counters->latency_ns / 1e6 / requests : 0.0,
+        counters->max_latency_ns / 1e6);
+}
+
+static int serve(
+    const struct options* opts,
+    hypericum_signer_t* signer,
+    const unsigned char* pk,
+    int listen_fd)
+{
+    struct counters counters;
+    memset(&counters, 0, sizeof(counters));
+
+    size_t conn_cap = 16, conn_count = 0;
+    struct conn* conns =
+        (struct conn*)malloc(conn_cap * sizeof(struct conn));
+    struct pollfd* fds =
+        (struct pollfd*)malloc((conn_cap + 1) * sizeof(struct pollfd));
+    struct request* requests =
+        (struct request*)malloc(opts->max_batch * sizeof(struct request));
+    if (NULL == conns || NULL == fds || NULL == requests) {
+        fprintf(stderr, "out of memory\n");
+        free(requests);
+        free(fds);
+        free(conns);
+        return -1;
+    }
+
+    while (!stopping) {
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < conn_count; i++) {
+            fds[i + 1].fd = conns[i].fd;
+            fds[i + 1].events =
+                (conns[i].out_len > 0 ? POLLOUT : 0) |
+                (conns[i].eof || conns[i].closing ||
+                         conns[i].out_len >= MAX_OUT_BYTES
+                     ? 0
+                     : POLLIN);
+        }
+
+        if (poll(fds, conn_count + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        // read everything that arrived, so that concurrent requests form
+        // one batch
+        for (size_t i = 0; i < conn_count; i++) {
+            struct conn* conn = &conns[i];
+            if (fds[i + 1].revents & POLLOUT) {
+                ssize_t n = write(conn->fd, conn->out, conn->out_len);
+                if (n > 0) {
+                    memmove(conn->out, conn->out + n, conn->out_len - n);
+                    conn->out_len -= (size_t)n;
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    conn->closing = 1;
+                    conn->out_len = 0;
+                }
+            }
+            if (!conn->eof && !conn->closing &&
+                (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                if (reserve(&conn->in, &conn->in_cap,
+                            conn->in_len + 65536) != 0) {
+                    conn->closing = 1;
+                    continue;
+                }
+                ssize_t n = read(
+                    conn->fd, conn->in + conn->in_len,
+                    conn->in_cap - conn->in_len);
+                if (n > 0) {
+                    conn->in_len += (size_t)n;
+                } else if (n == 0) {
+                    // requests already read are still answered
+                    conn->eof = 1;
+                } else if (errno != EAGAIN && errno != EINTR) {
+                    conn->closing = 1;
+                    conn->out_len = 0;
+                }
+            }
+        }
+
+        // serve the requests, connections in turn
+        size_t count = 0;
+        for (int more = 1; more;) {
+            more = 0;
+            for (size_t i = 0; i < conn_count; i++) {
+                size_t added = parse_requests(
+                    opts, &conns[i], requests + count,
+                    count + 1 <= opts->max_batch &&
+                            conns[i].out_len < MAX_OUT_BYTES
+                        ? 1
+                        : 0);
+                count += added;
+                more |= added > 0;
+            }
+            if (count == opts->max_batch || (!more && count > 0)) {
+                serve_batch(signer, pk, &counters, requests, count);
+                count = 0;
+                more = 1;
+            }
+        }
+
+        // drop closed connections once their responses are written
+        for (size_t i = 0; i < conn_count;) {
+            if ((conns[i].eof || conns[i].closing) && conns[i].out_len == 0) {
+                close_conn(&conns[i]);
+                conns[i] = conns[--conn_count];
+            } else {
+                i++;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0 && conn_count == conn_cap) {
+                struct conn* c = (struct conn*)realloc(
+                    conns, 2 * conn_cap * sizeof(struct conn));
+                struct pollfd* f = NULL;
+                if (NULL != c) {
+                    conns = c;
+                    f = (struct pollfd*)realloc(
+                        fds, (2 * conn_cap + 1) * sizeof(struct pollfd));
+                }
+                if (NULL != f) {
+                    fds = f;
+                    conn_cap *= 2;
+                }
+            }
+            if (fd >= 0 && conn_count < conn_cap) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                memset(&conns[conn_count], 0, sizeof(struct conn));
+                conns[conn_count++].fd = fd;
+                counters.connections++;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < conn_count; i++) {
+        close_conn(&conns[i]);
+    }
+    print_counters(&counters);
+
+    free(requests);
+    free(fds);
+    free(conns);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    struct options opts = {
+        .threads = 1,
+        .cache_subtrees = default_cache_subtrees(),
+        .max_batch = 256,
+        .max_message = 1u << 20,
+    };
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        const unsigned long value = strtoul(argv[i + 1], NULL, 10);
+        if (strcmp(argv[i], "-j") == 0 && value > 0) {
+            opts.threads = (unsigned)value;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            opts.cache_subtrees = value;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            opts.cache_path = argv[i + 1];
+        } else if (strcmp(argv[i], "-b") == 0 && value > 0) {
+            opts.max_batch = value;
+        } else if (strcmp(argv[i], "-m") == 0 && value <= UINT32_MAX) {
+            opts.max_message = value;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (argc - i != 2) {
+        usage();
+        return 2;
+    }
+
+#ifdef __linux__
+    // keep the key out of core dumps and away from debuggers of other
+    // processes of the user
+    prctl(PR_SET_DUMPABLE, 0);
+#endif  // __linux__
+
+    if (opts.threads > 1) {
+        int err = hypericum_set_threads(opts.threads);
+        if (err != 0) {
+            fprintf(stderr, "cannot use %u threads: %s\n", opts.threads,
+                    strerror(err));
+            return 2;
+        }
+    }
+
+    size_t sk_len = 0;
+    unsigned char* sk = read_key(argv[i], &sk_len);
+    if (NULL == sk) {
+        return 1;
+    }
+    unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+    memcpy(pk, sk + HYP_SECRET_KEY_BYTES - CRYPTO_PUBLICKEYBYTES, sizeof(pk));
+
+    hypericum_signer_t* signer = NULL;
+    int ret = NULL != opts.cache_path
+                  ? hypericum_signer_new_file_cache(
+                        sk, sk_len, opts.cache_subtrees, opts.cache_path,
+                        &signer)
+                  : hypericum_signer_new(
+                        sk, sk_len, opts.cache_subtrees, &signer);
+    memset(sk, 0, sk_len);
+    free(sk);
+    if (ret != 0) {
+        fprintf(stderr, "%s: cannot load the key: %s\n", argv[i],
+                strerror(ret));
+        return 1;
+    }
+
+    int listen_fd = listen_on(argv[i + 1]);
+    if (listen_fd < 0) {
+        hypericum_signer_free(signer);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    ret = serve(&opts, signer, pk, listen_fd);
+
+    close(listen_fd);
+    unlink(argv[i + 1]);
+    hypericum_signer_free(signer);
+    return ret == 0 ? 0 : 1;
+}
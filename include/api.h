@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include "hypericum_reject.h"
 #include "params.h"
 
 #include <stddef.h>
@@ -52,3 +53,304 @@ int crypto_sign_open(
     const unsigned char* sm,
     unsigned long long smlen,
     const unsigned char* pk);
+
+/**
+ * @brief Generates a key pair as `crypto_sign_keypair` with an extended
+ * secret key of `HYP_SECRET_KEY_EXT_BYTES`: the secret key of
+ * `CRYPTO_SECRETKEYBYTES` followed by the whole top layer XMSS tree, which
+ * `hypericum_signer_new` and `hypericum_service_new` read instead of
+ * building it for every signature. Its first `CRYPTO_SECRETKEYBYTES` bytes
+ * are a usual secret key.
+ * @return 0 on success or an error code.
+ */
+int hypericum_generate_keys_ext(unsigned char* sk_ext, unsigned char* pk);
+
+/**
+ * Durations of the phases of one signing or verification in nanoseconds.
+ */
+typedef struct hypericum_timings_st
+{
+    /// PRF_msg of the randomizer when signing, H_msg when verifying
+    uint64_t msg_hash_ns;
+    /// H_msg of the nonce candidates when signing
+    uint64_t grind_ns;
+    /// FORS+C signature or public key from the signature
+    uint64_t fors_ns;
+    /// hypertree signature or its verification
+    uint64_t hypertree_ns;
+    /// nonce candidates tried when signing
+    uint32_t grind_iterations;
+} hypericum_timings_t;
+
+/**
+ * @brief Signs `m` into a detached signature of `CRYPTO_BYTES` bytes. The
+ * message is only read for hashing, it is neither copied nor modified.
+ * @return 0 on success or an error code.
+ */
+int hypericum_sign_detached(
+    unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* sk);
+
+/**
+ * @brief Verifies the detached signature `sig` of `CRYPTO_BYTES` bytes of
+ * `m`, which is only read for hashing.
+ * @return 0 if the signature is valid, otherwise a `HYPERICUM_REJECT_`
+ * reason or an error code.
+ */
+int hypericum_verify_detached(
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* pk);
+
+/**
+ * @brief Same as `hypericum_sign_detached` and `hypericum_verify_detached`,
+ * the durations of the phases go to `timings`.
+ */
+int hypericum_sign_detached_timed(
+    unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* sk,
+    hypericum_timings_t* timings);
+
+int hypericum_verify_detached_timed(
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    const unsigned char* pk,
+    hypericum_timings_t* timings);
+
+/**
+ * @brief Sets the number of threads used for signing, key generation and
+ * batch verification, including the calling thread. FORS+C trees of a
+ * signature, the leaves of every XMSS subtree and the items of a batch are
+ * distributed over the threads.
+ * 1 (the default) runs everything on the calling thread.
+ * @return 0 on success, EINVAL for 0 threads, ENOSYS if the library is built
+ * without threads and `threads` is above 1, or the error of thread creation.
+ */
+int hypericum_set_threads(unsigned threads);
+
+/**
+ * Signing context of one secret key. Everything that only depends on the
+ * key is prepared once: the hash states of the key seeds, an optional node
+ * cache and, for an extended secret key, the top layer XMSS tree.
+ * A signer is used by one thread at a time.
+ */
+typedef struct hypericum_signer_st hypericum_signer_t;
+
+/**
+ * Verification context of one public key. A verifier may be shared by
+ * threads.
+ */
+typedef struct hypericum_verifier_st hypericum_verifier_t;
+
+/**
+ * @brief Creates a signing context.
+ * @param sk secret key of `CRYPTO_SECRETKEYBYTES` or extended secret key of
+ * `HYP_SECRET_KEY_EXT_BYTES`, whose tree is checked node by node here so
+ * that signing can trust it.
+ * @param sk_len length of `sk`.
+ * @param cache_subtrees number of XMSS subtrees kept between signatures,
+ * 0 for none; the upper layers of the hypertree are kept first.
+ * @param[out] signer created context.
+ * @return 0 on success, EINVAL for a wrong key length or an extended key
+ * whose tree is not the one of the public key, or ENOMEM.
+ */
+int hypericum_signer_new(
+    const unsigned char* sk,
+    size_t sk_len,
+    size_t cache_subtrees,
+    hypericum_signer_t** signer);
+
+/**
+ * @brief Same as `hypericum_signer_new` with the XMSS subtrees kept in the
+ * memory-mapped file `cache_path`, created if needed, so that they outlive
+ * the process. Signers of one process or of several may share the file.
+ * Signatures made with subtrees read from the file are verified before they
+ * are released. Not available on Windows.
+ * @param cache_subtrees number of subtrees of a new file, at least 1; an
+ * existing file of the same parameter set keeps its size.
+ * @return the errors of `hypericum_signer_new`, EINVAL if `cache_subtrees`
+ * is 0, ENOSYS on Windows, or the error of opening the file.
+ */
+int hypericum_signer_new_file_cache(
+    const unsigned char* sk,
+    size_t sk_len,
+    size_t cache_subtrees,
+    const char* cache_path,
+    hypericum_signer_t** signer);
+
+void hypericum_signer_free(hypericum_signer_t* signer);
+
+/**
+ * @brief Signs `m` into a signature of `CRYPTO_BYTES` bytes.
+ * @return 0 on success or an error code.
+ */
+int hypericum_signer_sign(
+    hypericum_signer_t* signer,
+    const unsigned char* m,
+    size_t mlen,
+    unsigned char* sig);
+
+// Same as above, the durations of the phases go to `timings`.
+int hypericum_signer_sign_timed(
+    hypericum_signer_t* signer,
+    const unsigned char* m,
+    size_t mlen,
+    unsigned char* sig,
+    hypericum_timings_t* timings);
+
+/**
+ * @brief Signs `count` messages at once: `sigs[i]` receives the signature of
+ * `CRYPTO_BYTES` bytes of the message `msgs[i]` of length `mlens[i]`.
+ *
+ * Upper hypertree layers have few subtrees, which the messages of a batch
+ * share: they are built once, distributed over the threads set by
+ * `hypericum_set_threads`, instead of once per message. The messages are
+ * then signed in order, so the signatures are byte for byte those of
+ * signing them one after another with the same generator.
+ * @return 0 on success or an error code, in which case `sigs` are
+ * incomplete.
+ */
+int hypericum_sign_batch(
+    const unsigned char* sk,
+    const unsigned char* const* msgs,
+    const size_t* mlens,
+    size_t count,
+    unsigned char* const* sigs);
+
+// Same as above with the prepared state of `signer`.
+int hypericum_signer_sign_batch(
+    hypericum_signer_t* signer,
+    const unsigned char* const* msgs,
+    const size_t* mlens,
+    size_t count,
+    unsigned char* const* sigs);
+
+/**
+ * @brief Creates a verification context.
+ * @param pk public key of `CRYPTO_PUBLICKEYBYTES`.
+ * @param[out] verifier created context.
+ * @return 0 on success or ENOMEM.
+ */
+int hypericum_verifier_new(
+    const unsigned char* pk, hypericum_verifier_t** verifier);
+
+void hypericum_verifier_free(hypericum_verifier_t* verifier);
+
+/**
+ * @brief Verifies the signature `sig` of `CRYPTO_BYTES` bytes of `m`.
+ * @return 0 if the signature is valid, otherwise a `HYPERICUM_REJECT_`
+ * reason or an error code.
+ */
+int hypericum_verifier_verify(
+    const hypericum_verifier_t* verifier,
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen);
+
+/**
+ * @brief Verifies `count` signatures at once: item `i` is the signature
+ * `sigs[i]` of `CRYPTO_BYTES` bytes of the message `msgs[i]` of length
+ * `mlens[i]` under the public key `pks[i]`. The items are distributed over
+ * the threads set by `hypericum_set_threads`; items under one public key
+ * share its precomputed hash states when they are adjacent.
+ * @param[out] results per-item results, as of `hypericum_verifier_verify`;
+ * every item gets one, an item that could not be verified gets the error.
+ * @return 0 if all signatures are valid, 1 if some are rejected, or the
+ * error of the first item that could not be verified.
+ */
+int hypericum_verify_batch(
+    const unsigned char* const* pks,
+    const unsigned char* const* msgs,
+    const size_t* mlens,
+    const unsigned char* const* sigs,
+    size_t count,
+    int* results);
+
+/**
+ * Incremental signing of a message given in chunks, for messages that are
+ * not kept in memory.
+ *
+ * A signature hashes the whole message several times: once for the
+ * randomizer R and once for every candidate of the digest search. A stream
+ * therefore signs in pre-hash mode, the signed message is the ASCII label
+ * `Hypericum/prehash/Streebog-256` followed by the Streebog-256 hash of the
+ * stream. Such signatures are checked by a verification stream in pre-hash
+ * mode, they do not verify as signatures of the stream itself.
+ */
+typedef struct hypericum_sign_stream_st hypericum_sign_stream_t;
+
+/**
+ * Incremental verification of a message given in chunks, of either a
+ * signature of the message itself or a signature of a signing stream.
+ */
+typedef struct hypericum_verify_stream_st hypericum_verify_stream_t;
+
+/**
+ * @brief Starts a signing stream with the secret key `sk`.
+ * @return 0 on success or ENOMEM.
+ */
+int hypericum_sign_stream_new(
+    const unsigned char* sk, hypericum_sign_stream_t** stream);
+
+/**
+ * @brief Absorbs the next chunk of the message.
+ */
+void hypericum_sign_stream_update(
+    hypericum_sign_stream_t* stream, const unsigned char* m, size_t mlen);
+
+/**
+ * @brief Signs the stream into a signature of `CRYPTO_BYTES` bytes. The
+ * stream can only be freed afterwards.
+ * @return 0 on success or an error code.
+ */
+int hypericum_sign_stream_final(
+    hypericum_sign_stream_t* stream, unsigned char* sig);
+
+// Same as above, the durations of the phases after hashing the stream go to
+// `timings`.
+int hypericum_sign_stream_final_timed(
+    hypericum_sign_stream_t* stream,
+    unsigned char* sig,
+    hypericum_timings_t* timings);
+
+void hypericum_sign_stream_free(hypericum_sign_stream_t* stream);
+
+/**
+ * @brief Starts a verification stream of the signature `sig` of
+ * `CRYPTO_BYTES` bytes under the public key `pk`.
+ * @param prehashed 0 for a signature of the message itself, 1 for a
+ * signature made by a signing stream.
+ * @return 0 on success or ENOMEM.
+ */
+int hypericum_verify_stream_new(
+    const unsigned char* sig,
+    const unsigned char* pk,
+    int prehashed,
+    hypericum_verify_stream_t** stream);
+
+/**
+ * @brief Absorbs the next chunk of the message.
+ */
+void hypericum_verify_stream_update(
+    hypericum_verify_stream_t* stream, const unsigned char* m, size_t mlen);
+
+/**
+ * @brief Completes the verification. The stream can only be freed
+ * afterwards.
+ * @return 0 if the signature is valid, otherwise a `HYPERICUM_REJECT_`
+ * reason or an error code.
+ */
+int hypericum_verify_stream_final(hypericum_verify_stream_t* stream);
+
+// Same as above, the durations of the phases go to `timings`. In pure mode
+// `msg_hash_ns` only covers the completion of the message digest.
+int hypericum_verify_stream_final_timed(
+    hypericum_verify_stream_t* stream, hypericum_timings_t* timings);
+
+void hypericum_verify_stream_free(hypericum_verify_stream_t* stream);
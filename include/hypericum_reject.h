@@ -26,10 +26,17 @@
 
 #pragma once
 
-// Opaque type to represent a stack
-typedef struct stack_node_t stack_root_t;
-
-int stack_is_empty(stack_root_t* root);
-void stack_push(stack_root_t** root, void* data);
-void* stack_pop(stack_root_t** root);
-void* stack_peek(stack_root_t* root);
+/**
+ * Reasons to reject a signature, returned by verification instead of 0.
+ * They lie above the errno values returned on errors. Verification runs its
+ * checks from the cheapest to the most expensive one and stops at the first
+ * which fails, so malformed signatures cost little.
+ */
+/// the signed message is shorter than a signature
+#define HYPERICUM_REJECT_LENGTH 0x100
+/// the message digest does not meet the FORS+C condition on the nonce
+#define HYPERICUM_REJECT_DIGEST 0x101
+/// the WOTS+C digit sum of a hypertree layer is wrong
+#define HYPERICUM_REJECT_WOTS 0x102
+/// the hypertree root is not the one of the public key
+#define HYPERICUM_REJECT_ROOT 0x103
@@ -0,0 +1,185 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "api.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Asynchronous signing and verification service.
+ *
+ * Jobs are submitted to a bounded queue and run by a pool of worker threads
+ * of the service. Every worker signs with a signer context of its own, see
+ * `hypericum_signer_new`, and draws random nonces from a generator of its
+ * own. The completion of a job is reported by a callback on the worker
+ * thread, by a future, or both.
+ *
+ * Buffers passed to a job must stay valid until it is completed. Functions
+ * of a service may be called from any thread. Workers run jobs on their own
+ * thread only: the threads set by `hypericum_set_threads` serve one
+ * signature at a time and are only used by a worker which finds them idle.
+ *
+ * The service needs the library built with threads.
+ */
+typedef struct hypericum_service_st hypericum_service_t;
+
+/**
+ * Completion handle of a job.
+ */
+typedef struct hypericum_future_st hypericum_future_t;
+
+/**
+ * @brief Completion callback, called on the worker thread once the job is
+ * done.
+ * @param user argument given at submission.
+ * @param result 0 if a signature was made or is valid, otherwise the error
+ * code of signing or the result of verification.
+ */
+typedef void (*hypericum_service_done_t)(void* user, int result);
+
+typedef struct hypericum_service_config_st
+{
+    /// worker threads, at least 1
+    unsigned workers;
+    /// jobs waiting in the queue at most, at least 1
+    size_t queue_capacity;
+    /// XMSS subtrees cached by the signer of every worker, 0 for none
+    size_t cache_subtrees;
+    /// 1 to make a submission to a full queue wait, 0 to reject it
+    int block_when_full;
+    /// file of XMSS subtrees shared by the signers of all workers instead,
+    /// of `cache_subtrees` subtrees if new, or NULL; see
+    /// `hypericum_signer_new_file_cache`
+    const char* cache_path;
+} hypericum_service_config_t;
+
+// Buckets of the latency histograms
+#define HYPERICUM_SERVICE_LATENCY_BUCKETS 32
+
+/**
+ * Counters of a service. Latency is the time from the submission of a job
+ * to its completion. Bucket `i` of a histogram counts jobs with a latency
+ * in `[2^i, 2^(i+1))` microseconds, the first one also those below 1 us and
+ * the last one all above.
+ */
+typedef struct hypericum_service_stats_st
+{
+    /// jobs accepted into the queue
+    uint64_t submitted;
+    /// jobs rejected because the queue was full
+    uint64_t rejected;
+    /// jobs completed, including failed ones
+    uint64_t completed;
+    /// signing jobs which returned an error
+    uint64_t failed;
+    /// jobs waiting in the queue now
+    size_t queued;
+    uint64_t sign_latency[HYPERICUM_SERVICE_LATENCY_BUCKETS];
+    uint64_t verify_latency[HYPERICUM_SERVICE_LATENCY_BUCKETS];
+} hypericum_service_stats_t;
+
+/**
+ * @brief Starts a service and its workers.
+ * @param sk secret key of `CRYPTO_SECRETKEYBYTES` or extended secret key of
+ * `HYP_SECRET_KEY_EXT_BYTES` used by signing jobs, or NULL for a service
+ * which only verifies.
+ * @param sk_len length of `sk`.
+ * @param config service configuration.
+ * @param[out] service started service.
+ * @return 0 on success, EINVAL for a wrong configuration or key, ENOMEM,
+ * ENOSYS if the library is built without threads, or the error of thread
+ * creation.
+ */
+int hypericum_service_new(
+    const unsigned char* sk,
+    size_t sk_len,
+    const hypericum_service_config_t* config,
+    hypericum_service_t** service);
+
+/**
+ * @brief Stops accepting jobs, completes all queued ones and stops the
+ * workers. Futures of the service must be freed before.
+ */
+void hypericum_service_free(hypericum_service_t* service);
+
+/**
+ * @brief Submits the signing of `m` into `sig` of `CRYPTO_BYTES` bytes.
+ * @param done optional completion callback.
+ * @param user argument of `done`.
+ * @param[out] future optional future of the job, to be released with
+ * `hypericum_future_free`.
+ * @return 0 if the job is queued, EAGAIN if the queue is full and the
+ * service does not wait, EINVAL for a service without a secret key,
+ * ECANCELED if the service is being freed, or ENOMEM.
+ */
+int hypericum_service_sign(
+    hypericum_service_t* service,
+    const unsigned char* m,
+    size_t mlen,
+    unsigned char* sig,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future);
+
+/**
+ * @brief Submits the verification of the signature `sig` of `CRYPTO_BYTES`
+ * bytes of `m` under the public key `pk`. Arguments and return values are
+ * the same as for `hypericum_service_sign`, but for the key.
+ */
+int hypericum_service_verify(
+    hypericum_service_t* service,
+    const unsigned char* pk,
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future);
+
+/**
+ * @brief Reads the counters of the service.
+ */
+void hypericum_service_stats(
+    hypericum_service_t* service, hypericum_service_stats_t* stats);
+
+/**
+ * @brief Tells whether the job is completed, without waiting.
+ */
+int hypericum_future_ready(hypericum_future_t* future);
+
+/**
+ * @brief Waits until the job is completed.
+ * @return result of the job, as passed to the completion callback.
+ */
+int hypericum_future_wait(hypericum_future_t* future);
+
+/**
+ * @brief Waits until the job is completed and releases the future.
+ */
+void hypericum_future_free(hypericum_future_t* future);
@@ -63,6 +63,13 @@
 #define HYP_SECRET_KEY_BYTES \
     (HYPERICUM_N_BYTES + HYPERICUM_N_BYTES + HYP_PUBLIC_KEY_BYTES)
 
+// every node of the top layer XMSS tree, 2^(h'+1) - 1 of them
+#define HYP_TOP_TREE_BYTES \
+    ((size_t)HYPERICUM_N_BYTES * ((2u << HYP_H_PRIME) - 1))
+
+// SK || top layer XMSS tree
+#define HYP_SECRET_KEY_EXT_BYTES (HYP_SECRET_KEY_BYTES + HYP_TOP_TREE_BYTES)
+
 // R + s + SIG_FORS + SIG_HT
 #define HYP_SIGNATURE_BYTES \
     (HYPERICUM_N_BYTES + 4 + HYP_FORSC_BYTES + HYP_XMSSMT_BYTES)
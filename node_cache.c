@@ -0,0 +1,426 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "node_cache.h"
+
+#include "params.h"
+#include "xmss.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else  // WIN32
+// there are no file caches to lock
+#define LOCK_SH 1
+#define LOCK_EX 2
+#define LOCK_UN 8
+#endif  // WIN32
+
+// A cache is one contiguous image, either allocated or mapped from a file:
+// the header, the entry table and `count` subtrees of HYP_XMSS_SUBTREE_BYTES
+// each. The image of a file is in the host byte order.
+//
+// Processes sharing a file lock it around every access: lookups take a
+// shared lock, changes of the header or the entry table an exclusive one.
+// An entry becomes valid only once its nodes are written.
+#define HYP_NODE_CACHE_MAGIC "HYPNODE1"
+#define HYP_NODE_CACHE_ALIGN 64
+
+struct hypericum_node_cache_header
+{
+    char magic[8];
+    uint32_t n;
+    uint32_t h;
+    uint32_t d;
+    uint32_t h_prime;
+    uint64_t count;
+    uint64_t clock;
+    uint8_t pk_seed[HYPERICUM_N_BYTES];
+    uint8_t pk_root[HYPERICUM_N_BYTES];
+    uint8_t bound;
+};
+
+struct hypericum_node_cache_entry
+{
+    uint64_t tree;
+    uint64_t last_use;
+    uint32_t layer;
+    uint32_t valid;
+};
+
+struct hypericum_node_cache_st
+{
+    struct hypericum_node_cache_header* header;
+    struct hypericum_node_cache_entry* entries;
+    uint8_t* nodes;
+    size_t count;
+
+    uint8_t* image;
+    size_t image_bytes;
+    // descriptor of the mapped file, -1 for an allocated image
+    int fd;
+};
+
+static size_t align_up(size_t value)
+{
+    return (value + HYP_NODE_CACHE_ALIGN - 1) &
+           ~(size_t)(HYP_NODE_CACHE_ALIGN - 1);
+}
+
+static size_t entries_offset()
+{
+    return align_up(sizeof(struct hypericum_node_cache_header));
+}
+
+static size_t nodes_offset(size_t count)
+{
+    return align_up(
+        entries_offset() + count * sizeof(struct hypericum_node_cache_entry));
+}
+
+static size_t image_bytes(size_t count)
+{
+    return nodes_offset(count) + count * HYP_XMSS_SUBTREE_BYTES;
+}
+
+static void attach_image(
+    hypericum_node_cache_t* cache, uint8_t* image, size_t count)
+{
+    cache->image = image;
+    cache->image_bytes = image_bytes(count);
+    cache->count = count;
+    cache->header = (struct hypericum_node_cache_header*)image;
+    cache->entries =
+        (struct hypericum_node_cache_entry*)(image + entries_offset());
+    cache->nodes = image + nodes_offset(count);
+}
+
+// Takes or releases the file lock, `op` as for flock. Allocated caches are
+// used by one thread and take no lock.
+static void lock_image(const hypericum_node_cache_t* cache, int op)
+{
+#ifndef WIN32
+    if (cache->fd >= 0) {
+        while (flock(cache->fd, op) != 0 && errno == EINTR) {
+        }
+    }
+#else  // WIN32
+    (void)cache;
+    (void)op;
+#endif  // WIN32
+}
+
+static void init_header(hypericum_node_cache_t* cache)
+{
+    memset(cache->header, 0, sizeof(struct hypericum_node_cache_header));
+    memcpy(cache->header->magic, HYP_NODE_CACHE_MAGIC, 8);
+    cache->header->n = HYPERICUM_N_BYTES;
+    cache->header->h = HYP_H;
+    cache->header->d = HYP_D;
+    cache->header->h_prime = HYP_H_PRIME;
+    cache->header->count = cache->count;
+    memset(
+        cache->entries, 0,
+        cache->count * sizeof(struct hypericum_node_cache_entry));
+}
+
+hypericum_node_cache_t* hypericum_node_cache_new(size_t max_subtrees)
+{
+    if (max_subtrees == 0) {
+        return NULL;
+    }
+
+    hypericum_node_cache_t* cache =
+        (hypericum_node_cache_t*)calloc(1, sizeof(hypericum_node_cache_t));
+    if (NULL == cache) {
+        return NULL;
+    }
+
+    uint8_t* image = (uint8_t*)calloc(1, image_bytes(max_subtrees));
+    if (NULL == image) {
+        free(cache);
+        return NULL;
+    }
+    attach_image(cache, image, max_subtrees);
+    cache->fd = -1;
+    init_header(cache);
+
+    return cache;
+}
+
+#ifndef WIN32
+
+// Checks that a header was written for the current parameter set.
+static int header_is_usable(const struct hypericum_node_cache_header* header)
+{
+    return memcmp(header->magic, HYP_NODE_CACHE_MAGIC, 8) == 0 &&
+           header->n == HYPERICUM_N_BYTES && header->h == HYP_H &&
+           header->d == HYP_D && header->h_prime == HYP_H_PRIME &&
+           header->count > 0;
+}
+
+// Checks the entry table of a mapped image.
+static int entries_are_usable(const hypericum_node_cache_t* cache)
+{
+    for (size_t i = 0; i < cache->count; ++i) {
+        if (cache->entries[i].valid && cache->entries[i].layer >= HYP_D) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Maps the file `fd` locked exclusively into `cache`, keeping an image of
+// the current parameter set and replacing anything else by an empty image
+// of `count` entries.
+static int map_image(hypericum_node_cache_t* cache, int fd, size_t count)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return errno;
+    }
+
+    // the image of a file already in use keeps its size, other processes
+    // have it mapped
+    struct hypericum_node_cache_header header;
+    int fresh = 1;
+    if ((size_t)st.st_size >= sizeof(header) &&
+        pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        header_is_usable(&header) &&
+        (size_t)st.st_size == image_bytes((size_t)header.count)) {
+        count = (size_t)header.count;
+        fresh = 0;
+    } else if (
+        ftruncate(fd, 0) != 0 ||
+        ftruncate(fd, (off_t)image_bytes(count)) != 0) {
+        return errno;
+    }
+
+    void* image = mmap(
+        NULL, image_bytes(count), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED) {
+        return errno;
+    }
+    attach_image(cache, (uint8_t*)image, count);
+    cache->fd = fd;
+
+    if (fresh || !entries_are_usable(cache)) {
+        init_header(cache);
+    }
+    return 0;
+}
+
+int hypericum_node_cache_open(
+    const char* path, size_t max_subtrees, hypericum_node_cache_t** result)
+{
+    if (max_subtrees == 0) {
+        return EINVAL;
+    }
+
+    hypericum_node_cache_t* cache =
+        (hypericum_node_cache_t*)calloc(1, sizeof(hypericum_node_cache_t));
+    if (NULL == cache) {
+        return ENOMEM;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        free(cache);
+        return errno;
+    }
+
+    int ret = 0;
+    while (flock(fd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            ret = errno;
+            break;
+        }
+    }
+    if (ret == 0) {
+        ret = map_image(cache, fd, max_subtrees);
+        flock(fd, LOCK_UN);
+    }
+    if (ret != 0) {
+        close(fd);
+        free(cache);
+        return ret;
+    }
+
+    *result = cache;
+    return 0;
+}
+
+#else  // WIN32
+
+int hypericum_node_cache_open(
+    const char* path, size_t max_subtrees, hypericum_node_cache_t** result)
+{
+    (void)path;
+    (void)max_subtrees;
+    (void)result;
+    return ENOSYS;
+}
+
+#endif  // WIN32
+
+int hypericum_node_cache_persistent(const hypericum_node_cache_t* cache)
+{
+    return cache->fd >= 0;
+}
+
+void hypericum_node_cache_free(hypericum_node_cache_t* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+#ifndef WIN32
+    if (cache->fd >= 0) {
+        munmap(cache->image, cache->image_bytes);
+        close(cache->fd);
+        free(cache);
+        return;
+    }
+#endif  // WIN32
+    free(cache->image);
+    free(cache);
+}
+
+// Drops all entries and the key binding, the image is locked exclusively.
+static void reset_image(hypericum_node_cache_t* cache)
+{
+    for (size_t i = 0; i < cache->count; ++i) {
+        cache->entries[i].valid = 0;
+    }
+    cache->header->bound = 0;
+}
+
+void hypericum_node_cache_reset(hypericum_node_cache_t* cache)
+{
+    lock_image(cache, LOCK_EX);
+    reset_image(cache);
+    lock_image(cache, LOCK_UN);
+}
+
+void hypericum_node_cache_bind(
+    hypericum_node_cache_t* cache,
+    const uint8_t* pk_seed,
+    const uint8_t* pk_root)
+{
+    struct hypericum_node_cache_header* header = cache->header;
+
+    lock_image(cache, LOCK_EX);
+    if (!header->bound ||
+        memcmp(header->pk_seed, pk_seed, HYPERICUM_N_BYTES) != 0 ||
+        memcmp(header->pk_root, pk_root, HYPERICUM_N_BYTES) != 0) {
+        if (header->bound) {
+            reset_image(cache);
+        }
+        memcpy(header->pk_seed, pk_seed, HYPERICUM_N_BYTES);
+        memcpy(header->pk_root, pk_root, HYPERICUM_N_BYTES);
+        header->bound = 1;
+    }
+    lock_image(cache, LOCK_UN);
+}
+
+const uint8_t* hypericum_node_cache_get(
+    hypericum_node_cache_t* cache,
+    uint32_t layer,
+    uint64_t tree,
+    uint8_t* nodes)
+{
+    const uint8_t* found = NULL;
+
+    // the nodes are copied under the lock, a writer sharing the file can't
+    // replace them while they are read
+    lock_image(cache, LOCK_SH);
+    for (size_t i = 0; i < cache->count; ++i) {
+        struct hypericum_node_cache_entry* entry = &cache->entries[i];
+        if (entry->valid && entry->layer == layer && entry->tree == tree) {
+            // readers of a shared file may stamp an entry at once, any of
+            // their stamps is recent enough for eviction
+            entry->last_use = cache->header->clock;
+            memcpy(
+                nodes, cache->nodes + i * HYP_XMSS_SUBTREE_BYTES,
+                HYP_XMSS_SUBTREE_BYTES);
+            found = nodes;
+            break;
+        }
+    }
+    lock_image(cache, LOCK_UN);
+    return found;
+}
+
+void hypericum_node_cache_put(
+    hypericum_node_cache_t* cache,
+    uint32_t layer,
+    uint64_t tree,
+    const uint8_t* nodes)
+{
+    lock_image(cache, LOCK_EX);
+    // a subtree of layer j is passed through by one signature in
+    // 2^(h' * (d - 1 - j)), so lower layers are evicted first and the least
+    // recently used entry only among them
+    size_t victim = 0;
+    for (size_t i = 0; i < cache->count; ++i) {
+        const struct hypericum_node_cache_entry* entry = &cache->entries[i];
+        const struct hypericum_node_cache_entry* worst =
+            &cache->entries[victim];
+        if (!entry->valid) {
+            victim = i;
+            break;
+        }
+        if (entry->layer < worst->layer ||
+            (entry->layer == worst->layer &&
+             entry->last_use < worst->last_use)) {
+            victim = i;
+        }
+    }
+
+    struct hypericum_node_cache_entry* entry = &cache->entries[victim];
+    if (entry->valid && layer < entry->layer) {
+        // the subtree is worth less than every cached one
+        lock_image(cache, LOCK_UN);
+        return;
+    }
+
+    // a writer dying half way leaves the entry invalid
+    entry->valid = 0;
+    memcpy(
+        cache->nodes + victim * HYP_XMSS_SUBTREE_BYTES, nodes,
+        HYP_XMSS_SUBTREE_BYTES);
+    entry->layer = layer;
+    entry->tree = tree;
+    entry->valid = 1;
+    entry->last_use = ++cache->header->clock;
+    lock_image(cache, LOCK_UN);
+}
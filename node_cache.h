@@ -0,0 +1,130 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cache of XMSS subtrees: every node from the WOTS+C leaf public keys up to
+ * the root, laid out as by `hypericum_xmss_subtree`.
+ *
+ * Nodes only depend on the key and on the (layer, tree) address of the
+ * subtree, so once computed they can be reused by every later signature
+ * that passes through the same subtree. The cache is bound to one key pair:
+ * binding it to another key drops all entries.
+ *
+ * A cache is either kept in memory or mapped from a file, so that the
+ * subtrees survive restarts of the signer. A file cache stores the key it is
+ * bound to in its header; subtree (layer, tree) lives in an entry slot and
+ * its node (height, index) at `hypericum_xmss_subtree_node` inside the slot.
+ *
+ * A cache object is not thread safe. Several cache objects, of one process
+ * or of several, may share a file: they lock it around every lookup and
+ * change, and an entry is valid only once its nodes are written.
+ */
+typedef struct hypericum_node_cache_st hypericum_node_cache_t;
+
+/**
+ * @brief Creates an empty cache.
+ * @param max_subtrees number of subtrees kept at once, each entry takes
+ * `HYP_XMSS_SUBTREE_BYTES` bytes.
+ * @return cache instance or `NULL` if out of memory.
+ */
+hypericum_node_cache_t* hypericum_node_cache_new(size_t max_subtrees);
+
+/**
+ * @brief Opens a cache backed by a memory-mapped file, creating the file if
+ * needed. A file written for the same parameter set is kept with its entries
+ * and size, any other file content is dropped. Not available on Windows.
+ *
+ * A lookup copies the nodes out of the file under the lock, so another
+ * cache sharing the file can't replace them while they are used. The file
+ * may still be damaged: signing therefore verifies hypertree signatures
+ * made with a file cache against the public key and re-signs without the
+ * cache on mismatch, so that a WOTS+C key never releases a signature of a
+ * wrong root.
+ *
+ * @param path cache file.
+ * @param max_subtrees number of subtrees of a new file.
+ * @param[out] cache opened cache.
+ * @return 0 on success, EINVAL if `max_subtrees` is 0, ENOSYS on Windows, or
+ * the error of a file operation.
+ */
+int hypericum_node_cache_open(
+    const char* path, size_t max_subtrees, hypericum_node_cache_t** cache);
+
+/**
+ * @brief Tells whether the cache is backed by a file.
+ */
+int hypericum_node_cache_persistent(const hypericum_node_cache_t* cache);
+
+void hypericum_node_cache_free(hypericum_node_cache_t* cache);
+
+/**
+ * @brief Drops all entries and the key binding.
+ */
+void hypericum_node_cache_reset(hypericum_node_cache_t* cache);
+
+/**
+ * @brief Binds the cache to a key pair, dropping entries of any other key.
+ * An unbound cache keeps its entries, which lets key generation fill the
+ * cache before the public key root is known.
+ * @param cache node cache.
+ * @param pk_seed public key seed of length HYPERICUM_N_BYTES.
+ * @param pk_root public key root of length HYPERICUM_N_BYTES.
+ */
+void hypericum_node_cache_bind(
+    hypericum_node_cache_t* cache,
+    const uint8_t* pk_seed,
+    const uint8_t* pk_root);
+
+/**
+ * @brief Looks up nodes of a subtree and copies them to `nodes`.
+ * @param[out] nodes `HYP_XMSS_SUBTREE_NODES` nodes of length
+ * HYPERICUM_N_BYTES.
+ * @return `nodes` or `NULL` if the subtree is not cached.
+ */
+const uint8_t* hypericum_node_cache_get(
+    hypericum_node_cache_t* cache,
+    uint32_t layer,
+    uint64_t tree,
+    uint8_t* nodes);
+
+/**
+ * @brief Stores the nodes of a subtree. A full cache evicts the least
+ * recently used entry of its lowest layer, or drops the subtree if every
+ * entry is of a higher layer: each signature passes through the top
+ * subtree but seldom through a given lower one, so even a cache of fewer
+ * than `HYP_D` subtrees keeps the upper layers.
+ * @param nodes `HYP_XMSS_SUBTREE_NODES` nodes of length HYPERICUM_N_BYTES.
+ */
+void hypericum_node_cache_put(
+    hypericum_node_cache_t* cache,
+    uint32_t layer,
+    uint64_t tree,
+    const uint8_t* nodes);
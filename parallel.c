@@ -0,0 +1,236 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "parallel.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+static int run_serial(uint32_t count, hypericum_task_t task, void* arg)
+{
+    int ret = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        int err = task(arg, i);
+        if (err != 0 && ret == 0) {
+            ret = err;
+        }
+    }
+    return ret;
+}
+
+#ifdef WITH_THREADS
+
+#include <pthread.h>
+
+struct hypericum_pool
+{
+    // serializes callers of hypericum_parallel_for
+    pthread_mutex_t run_lock;
+
+    // guards everything below
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    pthread_t* workers;
+    unsigned worker_count;
+    // also only written with run_lock held, which lets the holder read it
+    // without `lock`
+    unsigned threads;
+    int shutdown;
+
+    hypericum_task_t task;
+    void* arg;
+    uint32_t count;
+    uint32_t next;
+    uint32_t finished;
+    int ret;
+};
+
+static struct hypericum_pool pool = {
+    .run_lock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+    .threads = 1,
+};
+
+// Takes and runs tasks of the current job until none is left.
+// Called with pool.lock held, returns with it held.
+static void run_tasks()
+{
+    while (pool.next < pool.count) {
+        uint32_t index = pool.next++;
+        hypericum_task_t task = pool.task;
+        void* arg = pool.arg;
+
+        pthread_mutex_unlock(&pool.lock);
+        int err = task(arg, index);
+        pthread_mutex_lock(&pool.lock);
+
+        if (err != 0 && pool.ret == 0) {
+            pool.ret = err;
+        }
+        if (++pool.finished == pool.count) {
+            pthread_cond_broadcast(&pool.done_cond);
+        }
+    }
+}
+
+static void* worker_main(void* unused)
+{
+    (void)unused;
+
+    pthread_mutex_lock(&pool.lock);
+    while (!pool.shutdown) {
+        if (pool.next < pool.count) {
+            run_tasks();
+        } else {
+            pthread_cond_wait(&pool.work_cond, &pool.lock);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void stop_workers()
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.shutdown = 1;
+    pthread_cond_broadcast(&pool.work_cond);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (unsigned i = 0; i < pool.worker_count; ++i) {
+        pthread_join(pool.workers[i], NULL);
+    }
+    free(pool.workers);
+    pool.workers = NULL;
+    pool.worker_count = 0;
+    pool.shutdown = 0;
+}
+
+int hypericum_set_threads(unsigned threads)
+{
+    if (threads == 0) {
+        return EINVAL;
+    }
+
+    pthread_mutex_lock(&pool.run_lock);
+
+    stop_workers();
+    pthread_mutex_lock(&pool.lock);
+    pool.threads = 1;
+    pthread_mutex_unlock(&pool.lock);
+
+    int ret = 0;
+    if (threads > 1) {
+        pool.workers = (pthread_t*)calloc(threads - 1, sizeof(pthread_t));
+        if (NULL == pool.workers) {
+            ret = ENOMEM;
+        }
+        for (unsigned i = 0; ret == 0 && i < threads - 1; ++i) {
+            ret = pthread_create(&pool.workers[i], NULL, worker_main, NULL);
+            if (ret == 0) {
+                pool.worker_count++;
+            }
+        }
+        if (ret != 0) {
+            stop_workers();
+        } else {
+            pthread_mutex_lock(&pool.lock);
+            pool.threads = threads;
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+
+    pthread_mutex_unlock(&pool.run_lock);
+    return ret;
+}
+
+unsigned hypericum_parallel_threads()
+{
+    pthread_mutex_lock(&pool.lock);
+    unsigned threads = pool.threads;
+    pthread_mutex_unlock(&pool.lock);
+    return threads;
+}
+
+int hypericum_parallel_for(uint32_t count, hypericum_task_t task, void* arg)
+{
+    if (count < 2 || pthread_mutex_trylock(&pool.run_lock) != 0) {
+        return run_serial(count, task, arg);
+    }
+    if (pool.threads < 2) {
+        pthread_mutex_unlock(&pool.run_lock);
+        return run_serial(count, task, arg);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.arg = arg;
+    pool.count = count;
+    pool.next = 0;
+    pool.finished = 0;
+    pool.ret = 0;
+    pthread_cond_broadcast(&pool.work_cond);
+
+    run_tasks();
+    while (pool.finished < pool.count) {
+        pthread_cond_wait(&pool.done_cond, &pool.lock);
+    }
+
+    int ret = pool.ret;
+    pool.task = NULL;
+    pool.arg = NULL;
+    pool.count = 0;
+    pool.next = 0;
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.run_lock);
+    return ret;
+}
+
+#else  // WITH_THREADS
+
+int hypericum_set_threads(unsigned threads)
+{
+    if (threads == 0) {
+        return EINVAL;
+    }
+    return threads == 1 ? 0 : ENOSYS;
+}
+
+unsigned hypericum_parallel_threads()
+{
+    return 1;
+}
+
+int hypericum_parallel_for(uint32_t count, hypericum_task_t task, void* arg)
+{
+    return run_serial(count, task, arg);
+}
+
+#endif  // WITH_THREADS
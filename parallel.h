@@ -24,61 +24,34 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include "stack.h"
+#pragma once
 
-#include <stdint.h>
-#include <stdlib.h>
-
-
-// A structure to represent a stack
-struct stack_node_t
-{
-    void* data;
-    struct stack_node_t* next;
-};
-
-struct stack_node_t* stack_create_node(void* data)
-{
-    struct stack_node_t* node =
-        (struct stack_node_t*)calloc(1, sizeof(struct stack_node_t));
-    node->data = data;
-    node->next = NULL;
-    return node;
-}
-
-
-int stack_is_empty(struct stack_node_t* root)
-{
-    return !root;
-}
-
-
-void stack_push(struct stack_node_t** root, void* data)
-{
-    struct stack_node_t* stack_node_t = stack_create_node(data);
-    stack_node_t->next = *root;
-    *root = stack_node_t;
-}
-
-
-void* stack_pop(struct stack_node_t** root)
-{
-    if (stack_is_empty(*root)) {
-        return NULL;
-    }
-    struct stack_node_t* temp = *root;
-    *root = (*root)->next;
-    void* popped = temp->data;
-    free(temp);
-
-    return popped;
-}
+#include "api.h"
 
+#include <stdint.h>
 
-void* stack_peek(struct stack_node_t* root)
-{
-    if (stack_is_empty(root)) {
-        return NULL;
-    }
-    return root->data;
-}
+/**
+ * @brief Task body of `hypericum_parallel_for`.
+ * @param arg user argument passed to `hypericum_parallel_for`.
+ * @param index task index.
+ * @return 0 on success, error code otherwise.
+ */
+typedef int (*hypericum_task_t)(void* arg, uint32_t index);
+
+/**
+ * @brief Current number of threads, see `hypericum_set_threads`.
+ */
+unsigned hypericum_parallel_threads();
+
+/**
+ * @brief Runs `task(arg, i)` for every `i` in `[0, count)` on the worker
+ * pool and the calling thread and waits for all of them.
+ *
+ * Tasks must be independent of each other. The pool serves one call at a
+ * time: nested calls and calls made while the pool is busy run on the
+ * calling thread.
+ *
+ * @return 0 if all tasks succeeded, otherwise the error of one of the
+ * failed tasks.
+ */
+int hypericum_parallel_for(uint32_t count, hypericum_task_t task, void* arg);
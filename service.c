@@ -0,0 +1,505 @@
+/*
+   This product is distributed under 2-term BSD-license terms
+
+   Copyright (c) 2023, QApp. All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met: 
+
+   1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer. 
+   2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution. 
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "hypericum_service.h"
+
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WITH_THREADS
+
+#include <pthread.h>
+
+enum service_job_type
+{
+    service_job_sign,
+    service_job_verify,
+};
+
+// A job is its own future.
+struct hypericum_future_st
+{
+    hypericum_service_t* service;
+    enum service_job_type type;
+    const unsigned char* pk;
+    const unsigned char* msg;
+    size_t msg_len;
+    const unsigned char* sig;
+    unsigned char* result_sig;
+    hypericum_service_done_t done;
+    void* user;
+    uint64_t submitted_ns;
+
+    // guarded by the service lock, a job without a future is freed by the
+    // worker once completed
+    int has_future;
+    int completed;
+    int result;
+};
+
+struct service_worker
+{
+    hypericum_service_t* service;
+    // NULL for a service which only verifies
+    hypericum_signer_t* signer;
+    pthread_t thread;
+};
+
+struct hypericum_service_st
+{
+    // guards everything below but the workers
+    pthread_mutex_t lock;
+    // a job is queued or the service stops
+    pthread_cond_t work_cond;
+    // the queue has room or the service stops
+    pthread_cond_t space_cond;
+    // a job with a future is completed
+    pthread_cond_t done_cond;
+
+    // ring buffer of queued jobs
+    hypericum_future_t** queue;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int block_when_full;
+    int stopping;
+
+    hypericum_service_stats_t stats;
+
+    struct service_worker* workers;
+    unsigned worker_slots;
+    // workers whose thread is running
+    unsigned worker_count;
+    int can_sign;
+};
+
+// Bucket of a latency histogram, see `hypericum_service_stats_t`.
+static size_t latency_bucket(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    size_t bucket = 0;
+    while (us >= 2 && bucket < HYPERICUM_SERVICE_LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static int run_job(
+    const struct service_worker* worker, const hypericum_future_t* job)
+{
+    if (job->type == service_job_sign) {
+        return hypericum_signer_sign(
+            worker->signer, job->msg, job->msg_len, job->result_sig);
+    }
+    return hypericum_verify_detached(
+        job->sig, job->msg, job->msg_len, job->pk);
+}
+
+// Runs queued jobs until the service stops and the queue is empty.
+static void* worker_main(void* arg)
+{
+    const struct service_worker* worker = (const struct service_worker*)arg;
+    hypericum_service_t* service = worker->service;
+
+    pthread_mutex_lock(&service->lock);
+    for (;;) {
+        while (service->count == 0 && !service->stopping) {
+            pthread_cond_wait(&service->work_cond, &service->lock);
+        }
+        if (service->count == 0) {
+            break;
+        }
+
+        hypericum_future_t* job = service->queue[service->head];
+        service->head = (service->head + 1) % service->capacity;
+        service->count--;
+        pthread_cond_signal(&service->space_cond);
+        pthread_mutex_unlock(&service->lock);
+
+        int result = run_job(worker, job);
+        if (NULL != job->done) {
+            job->done(job->user, result);
+        }
+        const uint64_t latency = hypericum_time_ns() - job->submitted_ns;
+
+        pthread_mutex_lock(&service->lock);
+        hypericum_service_stats_t* stats = &service->stats;
+        stats->completed++;
+        if (job->type == service_job_sign) {
+            stats->failed += result != 0;
+            stats->sign_latency[latency_bucket(latency)]++;
+        } else {
+            stats->verify_latency[latency_bucket(latency)]++;
+        }
+
+        job->result = result;
+        job->completed = 1;
+        if (job->has_future) {
+            pthread_cond_broadcast(&service->done_cond);
+        } else {
+            free(job);
+        }
+    }
+    pthread_mutex_unlock(&service->lock);
+
+    return NULL;
+}
+
+// Stops the service once the queued jobs are completed.
+static void stop_workers(hypericum_service_t* service)
+{
+    pthread_mutex_lock(&service->lock);
+    service->stopping = 1;
+    pthread_cond_broadcast(&service->work_cond);
+    pthread_cond_broadcast(&service->space_cond);
+    pthread_mutex_unlock(&service->lock);
+
+    for (unsigned i = 0; i < service->worker_count; i++) {
+        pthread_join(service->workers[i].thread, NULL);
+    }
+    service->worker_count = 0;
+}
+
+int hypericum_service_new(
+    const unsigned char* sk,
+    size_t sk_len,
+    const hypericum_service_config_t* config,
+    hypericum_service_t** result)
+{
+    if (config->workers == 0 || config->queue_capacity == 0) {
+        return EINVAL;
+    }
+
+    hypericum_service_t* service =
+        (hypericum_service_t*)calloc(1, sizeof(hypericum_service_t));
+    if (NULL == service) {
+        return ENOMEM;
+    }
+    pthread_mutex_init(&service->lock, NULL);
+    pthread_cond_init(&service->work_cond, NULL);
+    pthread_cond_init(&service->space_cond, NULL);
+    pthread_cond_init(&service->done_cond, NULL);
+    service->capacity = config->queue_capacity;
+    service->block_when_full = config->block_when_full;
+    service->can_sign = NULL != sk;
+
+    int ret = ENOMEM;
+    service->queue = (hypericum_future_t**)calloc(
+        config->queue_capacity, sizeof(hypericum_future_t*));
+    service->workers = (struct service_worker*)calloc(
+        config->workers, sizeof(struct service_worker));
+    if (NULL == service->queue || NULL == service->workers) {
+        goto fail;
+    }
+    service->worker_slots = config->workers;
+
+    // every worker signs with a context of its own, so that workers never
+    // wait for each other
+    for (unsigned i = 0; i < config->workers; i++) {
+        service->workers[i].service = service;
+        if (NULL != sk &&
+            (ret = NULL != config->cache_path
+                       ? hypericum_signer_new_file_cache(
+                             sk, sk_len, config->cache_subtrees,
+                             config->cache_path, &service->workers[i].signer)
+                       : hypericum_signer_new(
+                             sk, sk_len, config->cache_subtrees,
+                             &service->workers[i].signer)) != 0) {
+            goto fail;
+        }
+    }
+
+    for (unsigned i = 0; i < config->workers; i++) {
+        ret = pthread_create(
+            &service->workers[i].thread, NULL, worker_main,
+            &service->workers[i]);
+        if (ret != 0) {
+            goto fail;
+        }
+        service->worker_count++;
+    }
+
+    *result = service;
+    return 0;
+
+fail:
+    hypericum_service_free(service);
+    return ret;
+}
+
+void hypericum_service_free(hypericum_service_t* service)
+{
+    if (NULL == service) {
+        return;
+    }
+
+    stop_workers(service);
+    if (NULL != service->workers) {
+        for (unsigned i = 0; i < service->worker_slots; i++) {
+            hypericum_signer_free(service->workers[i].signer);
+        }
+    }
+
+    pthread_cond_destroy(&service->done_cond);
+    pthread_cond_destroy(&service->space_cond);
+    pthread_cond_destroy(&service->work_cond);
+    pthread_mutex_destroy(&service->lock);
+    free(service->workers);
+    free(service->queue);
+    free(service);
+}
+
+// Queues a job, waiting for room if the service is configured so.
+static int submit(
+    hypericum_service_t* service,
+    hypericum_future_t* job,
+    hypericum_future_t** future)
+{
+    job->service = service;
+    job->has_future = NULL != future;
+    job->submitted_ns = hypericum_time_ns();
+
+    int ret = 0;
+    pthread_mutex_lock(&service->lock);
+    while (!service->stopping && service->count == service->capacity &&
+           service->block_when_full) {
+        pthread_cond_wait(&service->space_cond, &service->lock);
+    }
+
+    if (service->stopping) {
+        ret = ECANCELED;
+    } else if (service->count == service->capacity) {
+        service->stats.rejected++;
+        ret = EAGAIN;
+    } else {
+        service->queue[(service->head + service->count) % service->capacity] =
+            job;
+        service->count++;
+        service->stats.submitted++;
+        pthread_cond_signal(&service->work_cond);
+    }
+    pthread_mutex_unlock(&service->lock);
+
+    if (ret != 0) {
+        free(job);
+        return ret;
+    }
+    if (NULL != future) {
+        *future = job;
+    }
+    return 0;
+}
+
+int hypericum_service_sign(
+    hypericum_service_t* service,
+    const unsigned char* m,
+    size_t mlen,
+    unsigned char* sig,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future)
+{
+    if (!service->can_sign) {
+        return EINVAL;
+    }
+
+    hypericum_future_t* job =
+        (hypericum_future_t*)calloc(1, sizeof(hypericum_future_t));
+    if (NULL == job) {
+        return ENOMEM;
+    }
+    job->type = service_job_sign;
+    job->msg = m;
+    job->msg_len = mlen;
+    job->result_sig = sig;
+    job->done = done;
+    job->user = user;
+
+    return submit(service, job, future);
+}
+
+int hypericum_service_verify(
+    hypericum_service_t* service,
+    const unsigned char* pk,
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future)
+{
+    hypericum_future_t* job =
+        (hypericum_future_t*)calloc(1, sizeof(hypericum_future_t));
+    if (NULL == job) {
+        return ENOMEM;
+    }
+    job->type = service_job_verify;
+    job->pk = pk;
+    job->msg = m;
+    job->msg_len = mlen;
+    job->sig = sig;
+    job->done = done;
+    job->user = user;
+
+    return submit(service, job, future);
+}
+
+void hypericum_service_stats(
+    hypericum_service_t* service, hypericum_service_stats_t* stats)
+{
+    pthread_mutex_lock(&service->lock);
+    *stats = service->stats;
+    stats->queued = service->count;
+    pthread_mutex_unlock(&service->lock);
+}
+
+int hypericum_future_ready(hypericum_future_t* future)
+{
+    hypericum_service_t* service = future->service;
+
+    pthread_mutex_lock(&service->lock);
+    int completed = future->completed;
+    pthread_mutex_unlock(&service->lock);
+
+    return completed;
+}
+
+int hypericum_future_wait(hypericum_future_t* future)
+{
+    hypericum_service_t* service = future->service;
+
+    pthread_mutex_lock(&service->lock);
+    while (!future->completed) {
+        pthread_cond_wait(&service->done_cond, &service->lock);
+    }
+    int result = future->result;
+    pthread_mutex_unlock(&service->lock);
+
+    return result;
+}
+
+void hypericum_future_free(hypericum_future_t* future)
+{
+    if (NULL == future) {
+        return;
+    }
+
+    hypericum_future_wait(future);
+    free(future);
+}
+
+#else  // WITH_THREADS
+
+// Without threads a service cannot be created, the other functions are
+// never reached.
+
+int hypericum_service_new(
+    const unsigned char* sk,
+    size_t sk_len,
+    const hypericum_service_config_t* config,
+    hypericum_service_t** result)
+{
+    (void)sk;
+    (void)sk_len;
+    (void)config;
+    (void)result;
+    return ENOSYS;
+}
+
+void hypericum_service_free(hypericum_service_t* service)
+{
+    (void)service;
+}
+
+int hypericum_service_sign(
+    hypericum_service_t* service,
+    const unsigned char* m,
+    size_t mlen,
+    unsigned char* sig,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future)
+{
+    (void)service;
+    (void)m;
+    (void)mlen;
+    (void)sig;
+    (void)done;
+    (void)user;
+    (void)future;
+    return ENOSYS;
+}
+
+int hypericum_service_verify(
+    hypericum_service_t* service,
+    const unsigned char* pk,
+    const unsigned char* sig,
+    const unsigned char* m,
+    size_t mlen,
+    hypericum_service_done_t done,
+    void* user,
+    hypericum_future_t** future)
+{
+    (void)service;
+    (void)pk;
+    (void)sig;
+    (void)m;
+    (void)mlen;
+    (void)done;
+    (void)user;
+    (void)future;
+    return ENOSYS;
+}
+
+void hypericum_service_stats(
+    hypericum_service_t* service, hypericum_service_stats_t* stats)
+{
+    (void)service;
+    memset(stats, 0, sizeof(hypericum_service_stats_t));
+}
+
+int hypericum_future_ready(hypericum_future_t* future)
+{
+    (void)future;
+    return 1;
+}
+
+int hypericum_future_wait(hypericum_future_t* future)
+{
+    (void)future;
+    return ENOSYS;
+}
+
+void hypericum_future_free(hypericum_future_t* future)
+{
+    (void)future;
+}
+
+#endif  // WITH_THREADS
@@ -25,12 +25,15 @@
 */
 
 #include "api.h"
+#include "sign.h"
 #include "adrs.h"
 #include "drbg.h"
 #include "hash.h"
 #include "fors.h"
+#include "xmss.h"
 #include "xmssmt.h"
 #include "pack.h"
+#include "parallel.h"
 #include "params.h"
 #include "utils.h"
 #include "utils/intermediate.h"
@@ -39,6 +42,17 @@
 
 
 int hypericum_generate_keys(uint8_t* result_sk, uint8_t* result_pk)
+{
+    return hypericum_generate_keys_cached(result_sk, result_pk, NULL);
+}
+
+// Key generation, the top layer subtree goes to `top` if given, otherwise
+// to `cache` if given.
+static int generate_keys(
+    uint8_t* result_sk,
+    uint8_t* result_pk,
+    hypericum_node_cache_t* cache,
+    uint8_t* top)
 {
     const hash_algo_t hash_algo = hash_algo_new();
 
@@ -61,7 +75,19 @@ int hypericum_generate_keys(uint8_t* result_sk, uint8_t* result_pk)
         return ret;
     }
 
-    hypericum_generate_xmssmt_pk(hash_algo, sk.seed, pk.seed, pk.root);
+    if (cache != NULL) {
+        hypericum_node_cache_reset(cache);
+    }
+
+    if ((ret = hypericum_generate_xmssmt_pk(
+             hash_algo, sk.seed, pk.seed, cache, top, pk.root)) != 0) {
+        hash_algo_free(hash_algo);
+        return ret;
+    }
+
+    if (cache != NULL) {
+        hypericum_node_cache_bind(cache, pk.seed, pk.root);
+    }
 
     INTERMEDIATE_OUTPUT(print_sk(&sk));
     INTERMEDIATE_OUTPUT(print_pk(&pk));
@@ -72,6 +98,18 @@ int hypericum_generate_keys(uint8_t* result_sk, uint8_t* result_pk)
     return ret;
 }
 
+int hypericum_generate_keys_cached(
+    uint8_t* result_sk, uint8_t* result_pk, hypericum_node_cache_t* cache)
+{
+    return generate_keys(result_sk, result_pk, cache, NULL);
+}
+
+int hypericum_generate_keys_ext(uint8_t* result_sk_ext, uint8_t* result_pk)
+{
+    return generate_keys(
+        result_sk_ext, result_pk, NULL, result_sk_ext + HYP_SECRET_KEY_BYTES);
+}
+
 static uint32_t be_to_u32(uint8_t* a)
 {
     uint32_t ret = a[0];
@@ -90,41 +128,81 @@ static uint64_t be_to_u64(uint8_t* a)
     return ret;
 }
 
+// Adds the time since `clock` to the phase `field` of `timings` and restarts
+// `clock`, if timings are collected.
+#define TIMINGS_LAP(timings, field, clock)             \
+    do {                                               \
+        if (NULL != (timings)) {                       \
+            const uint64_t now = hypericum_time_ns();  \
+            (timings)->field += now - (clock);         \
+            (clock) = now;                             \
+        }                                              \
+    } while (0)
+
+// Clears `timings` and starts their clock.
+static uint64_t timings_start(hypericum_timings_t* timings)
+{
+    if (NULL == timings) {
+        return 0;
+    }
+    memset(timings, 0, sizeof(hypericum_timings_t));
+    return hypericum_time_ns();
+}
+
 int hypericum_sign(
     const uint8_t* sk_bytes,
     const uint8_t* msg,
     size_t msg_len,
     uint8_t* result_sig)
 {
-    int ret = 0;
-    const hash_algo_t hash_algo = hash_algo_new();
+    return hypericum_sign_cached(sk_bytes, msg, msg_len, NULL, result_sig);
+}
 
-    hypericum_sk_internal_t sk = hypericum_sk_parse((uint8_t*)sk_bytes);
-    hypericum_sig_internal_t sig = hypericum_sig_parse(result_sig);
+// First part of signing: the randomizer, the digest search and the FORS+C
+// signature into `sig`. Returns the FORS+C public key and the position in
+// the hypertree which signs it.
+static int sign_message_fors(
+    const hash_algo_t hash_algo,
+    const hypericum_sk_internal_t* sk,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_timings_t* timings,
+    uint64_t* clock,
+    hypericum_sig_internal_t* sig,
+    uint8_t* pk_fors,
+    uint64_t* idx_tree,
+    uint32_t* idx_leaf)
+{
+    int ret = 0;
 
-    hypericum_prf_msg(
-        hash_algo, sk.prf, sk.pk.seed, (const uint8_t*)HYPERICUM_OPT, msg,
-        msg_len, sig.r);
+    if ((ret = hypericum_prf_msg(
+             hash_algo, sk->prf, sk->pk.seed, (const uint8_t*)HYPERICUM_OPT,
+             msg, msg_len, sig->r)) != 0) {
+        return ret;
+    }
+    TIMINGS_LAP(timings, msg_hash_ns, *clock);
 
-    INTERMEDIATE_OUTPUT(print_sign_randomization_parameters(&sig));
+    INTERMEDIATE_OUTPUT(print_sign_randomization_parameters(sig));
 
     const uint32_t tmp_md_size = (HYP_K * HYP_B + 7) / 8;
     const uint32_t tmp_idx_tree_size = (HYP_H - HYP_H_PRIME + 7) / 8;
 
     uint8_t digest[64];
-    uint64_t idx_tree = 0;
-    uint32_t idx_leaf = 0;
     uint8_t s_found = 0;
 
     for (uint32_t i = 0; i < HYPERICUM_SIGN_MAX_ITERATIONS; ++i) {
-        if ((ret = randombytes(hash_algo, sig.s, sizeof(uint32_t))) != 0) {
-            hash_algo_free(hash_algo);
+        if ((ret = randombytes(hash_algo, sig->s, sizeof(uint32_t))) != 0) {
             return ret;
         }
 
-        hypericum_h_msg(
-            hash_algo, sig.r, sk.pk.seed, sk.pk.root, sig.s, msg, msg_len,
-            digest);
+        if ((ret = hypericum_h_msg(
+                 hash_algo, sig->r, sk->pk.seed, sk->pk.root, sig->s, msg,
+                 msg_len, digest)) != 0) {
+            return ret;
+        }
+        if (NULL != timings) {
+            timings->grind_iterations++;
+        }
 
         if (md_suffix_nonzero(digest)) {
             continue;
@@ -132,63 +210,204 @@ int hypericum_sign(
         s_found = 1;
 
         uint8_t* tmp_idx_tree = digest + tmp_md_size;
-        idx_tree = be_to_u64(tmp_idx_tree);
-        idx_tree >>= (64 - HYP_H + HYP_H_PRIME);
+        *idx_tree = be_to_u64(tmp_idx_tree);
+        *idx_tree >>= (64 - HYP_H + HYP_H_PRIME);
 
         uint8_t* tmp_idx_leaf = tmp_idx_tree + tmp_idx_tree_size;
-        idx_leaf = be_to_u32(tmp_idx_leaf);
-        idx_leaf >>= (32 - HYP_H_PRIME);
+        *idx_leaf = be_to_u32(tmp_idx_leaf);
+        *idx_leaf >>= (32 - HYP_H_PRIME);
         break;
     }
+    TIMINGS_LAP(timings, grind_ns, *clock);
 
-    INTERMEDIATE_OUTPUT(print_sign_preparation_data(sig.s, digest, idx_tree, idx_leaf));
+    INTERMEDIATE_OUTPUT(print_sign_preparation_data(sig->s, digest, *idx_tree, *idx_leaf));
 
-    hypericum_adrs_t* adrs = hypericum_adrs_create();
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
 
-    hypericum_adrs_set_layer_address(adrs, 0);
-    hypericum_adrs_set_tree_address(adrs, idx_tree);
-    hypericum_adrs_set_type(adrs, address_fors_tree);
-    hypericum_adrs_set_keypair_address(adrs, idx_leaf);
-    hypericum_sign_fors(
-        hash_algo, sk.seed, sk.pk.seed, digest, adrs, sig.sig_fors);
+    hypericum_adrs_set_layer_address(&adrs, 0);
+    hypericum_adrs_set_tree_address(&adrs, *idx_tree);
+    hypericum_adrs_set_type(&adrs, address_fors_tree);
+    hypericum_adrs_set_keypair_address(&adrs, *idx_leaf);
+    if ((ret = hypericum_sign_fors(
+             hash_algo, sk->seed, sk->pk.seed, digest, &adrs, sig->sig_fors,
+             pk_fors)) != 0) {
+        secure_erase(digest, 64);
+        return ret;
+    }
+    secure_erase(digest, 64);
+    TIMINGS_LAP(timings, fors_ns, *clock);
 
-    INTERMEDIATE_OUTPUT(print_sign_fors(&sig));
+    INTERMEDIATE_OUTPUT(print_sign_fors(sig));
+
+    return 0;
+}
+
+// Signing, the top layer subtree is read from `top` if given and the upper
+// layers from `batch` if given.
+static int sign_message(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    const hypericum_xmssmt_batch_t* batch,
+    hypericum_timings_t* timings,
+    uint8_t* result_sig)
+{
+    int ret = 0;
+    uint64_t clock = timings_start(timings);
+
+    hypericum_sk_internal_t sk = hypericum_sk_parse((uint8_t*)sk_bytes);
+    hypericum_sig_internal_t sig = hypericum_sig_parse(result_sig);
+
+    if (cache != NULL) {
+        hypericum_node_cache_bind(cache, sk.pk.seed, sk.pk.root);
+    }
 
     uint8_t pk_fors[HYPERICUM_N_BYTES];
-    hypericum_generate_fors_pk_from_sig(
-        hash_algo, sk.pk.seed, digest, sig.sig_fors, adrs, pk_fors);
+    uint64_t idx_tree = 0;
+    uint32_t idx_leaf = 0;
+    if ((ret = sign_message_fors(
+             hash_algo, &sk, msg, msg_len, timings, &clock, &sig, pk_fors,
+             &idx_tree, &idx_leaf)) != 0) {
+        return ret;
+    }
 
-    hypericum_adrs_set_type(adrs, address_tree);
-    hypericum_adrs_destroy(adrs);
-    secure_erase(digest, 64);
-    hypericum_sign_xmssmt(
-        hash_algo, sk.seed, sk.pk.seed, pk_fors, idx_tree, idx_leaf,
-        sig.sig_ht);
+    ret = batch != NULL
+              ? hypericum_sign_xmssmt_batch(
+                    hash_algo, sk.seed, sk.pk.seed, batch, pk_fors, idx_tree,
+                    idx_leaf, cache, sig.sig_ht)
+              : hypericum_sign_xmssmt(
+                    hash_algo, sk.seed, sk.pk.seed, pk_fors, idx_tree,
+                    idx_leaf, cache, top, sig.sig_ht);
+
+    // subtrees read from a file are not trusted: a damaged one would make the
+    // next layer sign a wrong root, so the result is checked before release
+    // and redone from subtrees built here, leaving the shared file as is
+    if (ret == 0 && cache != NULL && hypericum_node_cache_persistent(cache) &&
+        hypericum_verify_xmssmt(
+            hash_algo, sk.pk.seed, sig.sig_ht, pk_fors, idx_tree, idx_leaf,
+            sk.pk.root) != 0) {
+        ret = hypericum_sign_xmssmt(
+            hash_algo, sk.seed, sk.pk.seed, pk_fors, idx_tree, idx_leaf, NULL,
+            top, sig.sig_ht);
+    }
+    TIMINGS_LAP(timings, hypertree_ns, clock);
+
+    return ret;
+}
+
+// Same as above with a hash context of its own.
+static int sign_message_once(
+    const uint8_t* sk_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    hypericum_timings_t* timings,
+    uint8_t* result_sig)
+{
+    const hash_algo_t hash_algo = hash_algo_new();
+    if (NULL == hash_algo) {
+        return ENOMEM;
+    }
+
+    int ret = sign_message(
+        hash_algo, sk_bytes, msg, msg_len, cache, top, NULL, timings,
+        result_sig);
 
     hash_algo_free(hash_algo);
+    return ret;
+}
+
+int hypericum_sign_cached(
+    const uint8_t* sk_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_node_cache_t* cache,
+    uint8_t* result_sig)
+{
+    return sign_message_once(
+        sk_bytes, msg, msg_len, cache, NULL, NULL, result_sig);
+}
 
+int hypericum_sign_timed(
+    const uint8_t* sk_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_timings_t* timings,
+    uint8_t* result_sig)
+{
+    return sign_message_once(
+        sk_bytes, msg, msg_len, NULL, NULL, timings, result_sig);
+}
+
+// Checks that the top layer tree stored in an extended secret key is the one
+// the public key commits to: its root is the public key root and every other
+// node the hash of its children, which leaves no room for a damaged node.
+// Returns 0, EINVAL for a wrong tree, or ENOMEM.
+static int top_tree_check(
+    const hash_algo_t hash_algo, const uint8_t* sk_ext_bytes)
+{
+    const uint8_t* top = sk_ext_bytes + HYP_SECRET_KEY_BYTES;
+    hypericum_sk_internal_t sk = hypericum_sk_parse((uint8_t*)sk_ext_bytes);
+
+    if (memcmp(
+            hypericum_xmss_subtree_node(top, HYP_H_PRIME, 0), sk.pk.root,
+            HYPERICUM_N_BYTES) != 0) {
+        return EINVAL;
+    }
+
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
+    hypericum_adrs_set_layer_address(&adrs, HYP_D - 1);
+    hypericum_adrs_set_tree_address(&adrs, 0);
+    return hypericum_xmss_subtree_check(hash_algo, sk.pk.seed, &adrs, top);
+}
+
+int hypericum_sign_ext(
+    const uint8_t* sk_ext_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_node_cache_t* cache,
+    uint8_t* result_sig)
+{
+    const hash_algo_t hash_algo = hash_algo_new();
+    if (NULL == hash_algo) {
+        return ENOMEM;
+    }
+
+    int ret = top_tree_check(hash_algo, sk_ext_bytes);
+    if (ret == 0) {
+        ret = sign_message(
+            hash_algo, sk_ext_bytes, msg, msg_len, cache,
+            sk_ext_bytes + HYP_SECRET_KEY_BYTES, NULL, NULL, result_sig);
+    }
+
+    hash_algo_free(hash_algo);
     return ret;
 }
 
-int hypericum_verify(
+// Verification of a signature whose message digest is `digest`, the
+// timings of the FORS+C and hypertree phases are added to `timings`.
+static int verify_digest(
+    const hash_algo_t hash_algo,
     const uint8_t* pk_bytes,
     const uint8_t* sig_bytes,
-    const uint8_t* msg,
-    size_t msg_len)
+    uint8_t* digest,
+    hypericum_timings_t* timings)
 {
-    const hash_algo_t hash_algo = hash_algo_new();
+    uint64_t clock = NULL != timings ? hypericum_time_ns() : 0;
 
     hypericum_pk_internal_t pk = hypericum_pk_parse((uint8_t*)pk_bytes);
     hypericum_sig_internal_t sig = hypericum_sig_parse((uint8_t*)sig_bytes);
 
-    INTERMEDIATE_OUTPUT(print_verify_parsed_signature(&sig));
-
-    uint8_t digest[64];
-    hypericum_h_msg(
-        hash_algo, sig.r, pk.seed, pk.root, sig.s, msg, msg_len, digest);
+    // the cheapest check comes first: digests of forged or damaged
+    // signatures rarely meet the condition the signer ground the nonce for
     if (md_suffix_nonzero(digest)) {
-        hash_algo_free(hash_algo);
-        return 1;
+        return HYPERICUM_REJECT_DIGEST;
     }
 
     const uint32_t tmp_md_size = (HYP_K * HYP_B + 7) / 8;
@@ -204,24 +423,640 @@ int hypericum_verify(
 
     INTERMEDIATE_OUTPUT(print_verify_hash_data(digest, idx_tree, idx_leaf));
 
-    hypericum_adrs_t* adrs = hypericum_adrs_create();
-    hypericum_adrs_set_layer_address(adrs, 0);
-    hypericum_adrs_set_tree_address(adrs, idx_tree);
-    hypericum_adrs_set_type(adrs, address_fors_tree);
-    hypericum_adrs_set_keypair_address(adrs, idx_leaf);
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
+    hypericum_adrs_set_layer_address(&adrs, 0);
+    hypericum_adrs_set_tree_address(&adrs, idx_tree);
+    hypericum_adrs_set_type(&adrs, address_fors_tree);
+    hypericum_adrs_set_keypair_address(&adrs, idx_leaf);
 
     uint8_t pk_fors[HYPERICUM_N_BYTES];
     hypericum_generate_fors_pk_from_sig(
-        hash_algo, pk.seed, digest, sig.sig_fors, adrs, pk_fors);
+        hash_algo, pk.seed, digest, sig.sig_fors, &adrs, pk_fors);
+    TIMINGS_LAP(timings, fors_ns, clock);
 
     INTERMEDIATE_OUTPUT(print_verify_pk_fors(pk_fors));
 
-    hypericum_adrs_set_type(adrs, address_tree);
-    hypericum_adrs_destroy(adrs);
-    int ret = 1 - hypericum_verify_xmssmt(
-                      hash_algo, pk.seed, sig.sig_ht, pk_fors, idx_tree,
-                      idx_leaf, pk.root);
+    hypericum_adrs_set_type(&adrs, address_tree);
+    int ret = hypericum_verify_xmssmt(
+        hash_algo, pk.seed, sig.sig_ht, pk_fors, idx_tree, idx_leaf, pk.root);
+    TIMINGS_LAP(timings, hypertree_ns, clock);
+
+    return ret;
+}
+
+static int verify_message(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_bytes,
+    const uint8_t* sig_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_timings_t* timings)
+{
+    uint64_t clock = timings_start(timings);
+    hypericum_pk_internal_t pk = hypericum_pk_parse((uint8_t*)pk_bytes);
+    hypericum_sig_internal_t sig = hypericum_sig_parse((uint8_t*)sig_bytes);
+
+    INTERMEDIATE_OUTPUT(print_verify_parsed_signature(&sig));
+
+    uint8_t digest[64];
+    if (hypericum_h_msg(
+            hash_algo, sig.r, pk.seed, pk.root, sig.s, msg, msg_len,
+            digest) != 0) {
+        return ENOMEM;
+    }
+    TIMINGS_LAP(timings, msg_hash_ns, clock);
+
+    return verify_digest(hash_algo, pk_bytes, sig_bytes, digest, timings);
+}
+
+int hypericum_verify(
+    const uint8_t* pk_bytes,
+    const uint8_t* sig_bytes,
+    const uint8_t* msg,
+    size_t msg_len)
+{
+    return hypericum_verify_timed(pk_bytes, sig_bytes, msg, msg_len, NULL);
+}
+
+int hypericum_verify_timed(
+    const uint8_t* pk_bytes,
+    const uint8_t* sig_bytes,
+    const uint8_t* msg,
+    size_t msg_len,
+    hypericum_timings_t* timings)
+{
+    const hash_algo_t hash_algo = hash_algo_new();
+    if (NULL == hash_algo) {
+        return ENOMEM;
+    }
+
+    int ret = verify_message(
+        hash_algo, pk_bytes, sig_bytes, msg, msg_len, timings);
 
     hash_algo_free(hash_algo);
     return ret;
 }
+
+
+struct hypericum_signer_st
+{
+    hash_algo_t hash_algo;
+    hypericum_node_cache_t* cache;
+    // top layer subtree of an extended secret key or NULL
+    uint8_t* top;
+    uint8_t sk[HYP_SECRET_KEY_BYTES];
+};
+
+struct hypericum_verifier_st
+{
+    hash_algo_t hash_algo;
+    uint8_t pk[HYP_PUBLIC_KEY_BYTES];
+};
+
+// Creates a signer with a node cache in memory, or in the file `cache_path`
+// if given.
+static int signer_new(
+    const uint8_t* sk_bytes,
+    size_t sk_len,
+    size_t cache_subtrees,
+    const char* cache_path,
+    hypericum_signer_t** result)
+{
+    if (sk_len != HYP_SECRET_KEY_BYTES && sk_len != HYP_SECRET_KEY_EXT_BYTES) {
+        return EINVAL;
+    }
+
+    hypericum_signer_t* signer =
+        (hypericum_signer_t*)calloc(1, sizeof(hypericum_signer_t));
+    if (NULL == signer) {
+        return ENOMEM;
+    }
+    memcpy(signer->sk, sk_bytes, HYP_SECRET_KEY_BYTES);
+
+    int ret = ENOMEM;
+    signer->hash_algo = hash_algo_new();
+    if (NULL == signer->hash_algo) {
+        goto fail;
+    }
+
+    hypericum_sk_internal_t sk = hypericum_sk_parse(signer->sk);
+    if ((ret = hypericum_hash_set_keys(
+             signer->hash_algo, sk.pk.seed, sk.seed, sk.prf)) != 0) {
+        goto fail;
+    }
+
+    ret = ENOMEM;
+    if (NULL != cache_path) {
+        if ((ret = hypericum_node_cache_open(
+                 cache_path, cache_subtrees, &signer->cache)) != 0) {
+            goto fail;
+        }
+        ret = ENOMEM;
+    } else if (cache_subtrees > 0) {
+        signer->cache = hypericum_node_cache_new(cache_subtrees);
+        if (NULL == signer->cache) {
+            goto fail;
+        }
+    }
+    if (NULL != signer->cache) {
+        hypericum_node_cache_bind(signer->cache, sk.pk.seed, sk.pk.root);
+    }
+
+    if (sk_len == HYP_SECRET_KEY_EXT_BYTES) {
+        // the tree is checked once here instead of verifying signatures
+        if ((ret = top_tree_check(signer->hash_algo, sk_bytes)) != 0) {
+            goto fail;
+        }
+        ret = ENOMEM;
+        signer->top = (uint8_t*)malloc(HYP_TOP_TREE_BYTES);
+        if (NULL == signer->top) {
+            goto fail;
+        }
+        memcpy(
+            signer->top, sk_bytes + HYP_SECRET_KEY_BYTES, HYP_TOP_TREE_BYTES);
+    }
+
+    *result = signer;
+    return 0;
+
+fail:
+    hypericum_signer_free(signer);
+    return ret;
+}
+
+int hypericum_signer_new(
+    const uint8_t* sk_bytes,
+    size_t sk_len,
+    size_t cache_subtrees,
+    hypericum_signer_t** result)
+{
+    return signer_new(sk_bytes, sk_len, cache_subtrees, NULL, result);
+}
+
+int hypericum_signer_new_file_cache(
+    const uint8_t* sk_bytes,
+    size_t sk_len,
+    size_t cache_subtrees,
+    const char* cache_path,
+    hypericum_signer_t** result)
+{
+    return signer_new(sk_bytes, sk_len, cache_subtrees, cache_path, result);
+}
+
+void hypericum_signer_free(hypericum_signer_t* signer)
+{
+    if (NULL == signer) {
+        return;
+    }
+
+    if (NULL != signer->hash_algo) {
+        hypericum_hash_clear_keys(signer->hash_algo);
+        hash_algo_free(signer->hash_algo);
+    }
+    if (NULL != signer->cache) {
+        hypericum_node_cache_free(signer->cache);
+    }
+    if (NULL != signer->top) {
+        secure_erase(signer->top, HYP_TOP_TREE_BYTES);
+        free(signer->top);
+    }
+
+    secure_erase(signer->sk, HYP_SECRET_KEY_BYTES);
+    free(signer);
+}
+
+int hypericum_signer_sign(
+    hypericum_signer_t* signer,
+    const uint8_t* msg,
+    size_t msg_len,
+    uint8_t* result_sig)
+{
+    return sign_message(
+        signer->hash_algo, signer->sk, msg, msg_len, signer->cache,
+        signer->top, NULL, NULL, result_sig);
+}
+
+int hypericum_signer_sign_timed(
+    hypericum_signer_t* signer,
+    const uint8_t* msg,
+    size_t msg_len,
+    uint8_t* result_sig,
+    hypericum_timings_t* timings)
+{
+    return sign_message(
+        signer->hash_algo, signer->sk, msg, msg_len, signer->cache,
+        signer->top, NULL, timings, result_sig);
+}
+
+// Signs a batch message after message, exactly as one by one, with the
+// subtrees of the upper layers built once for all of them.
+static int sign_batch(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_bytes,
+    const uint8_t* const* msgs,
+    const size_t* msg_lens,
+    size_t count,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    uint8_t* const* result_sigs)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    hypericum_sk_internal_t sk = hypericum_sk_parse((uint8_t*)sk_bytes);
+    if (cache != NULL) {
+        hypericum_node_cache_bind(cache, sk.pk.seed, sk.pk.root);
+    }
+
+    hypericum_xmssmt_batch_t* batch = NULL;
+    int ret = hypericum_xmssmt_batch_new(
+        hash_algo, sk.seed, sk.pk.seed, count, cache, top, &batch);
+
+    for (size_t i = 0; ret == 0 && i < count; i++) {
+        ret = sign_message(
+            hash_algo, sk_bytes, msgs[i], msg_lens[i], cache, top, batch, NULL,
+            result_sigs[i]);
+    }
+
+    hypericum_xmssmt_batch_free(batch);
+    return ret;
+}
+
+int hypericum_sign_batch(
+    const uint8_t* sk_bytes,
+    const uint8_t* const* msgs,
+    const size_t* msg_lens,
+    size_t count,
+    uint8_t* const* result_sigs)
+{
+    const hash_algo_t hash_algo = hash_algo_new();
+    if (NULL == hash_algo) {
+        return ENOMEM;
+    }
+
+    int ret = sign_batch(
+        hash_algo, sk_bytes, msgs, msg_lens, count, NULL, NULL, result_sigs);
+
+    hash_algo_free(hash_algo);
+    return ret;
+}
+
+int hypericum_signer_sign_batch(
+    hypericum_signer_t* signer,
+    const uint8_t* const* msgs,
+    const size_t* msg_lens,
+    size_t count,
+    uint8_t* const* result_sigs)
+{
+    return sign_batch(
+        signer->hash_algo, signer->sk, msgs, msg_lens, count, signer->cache,
+        signer->top, result_sigs);
+}
+
+int hypericum_verifier_new(
+    const uint8_t* pk_bytes, hypericum_verifier_t** result)
+{
+    hypericum_verifier_t* verifier =
+        (hypericum_verifier_t*)calloc(1, sizeof(hypericum_verifier_t));
+    if (NULL == verifier) {
+        return ENOMEM;
+    }
+    memcpy(verifier->pk, pk_bytes, HYP_PUBLIC_KEY_BYTES);
+
+    verifier->hash_algo = hash_algo_new();
+    if (NULL == verifier->hash_algo) {
+        hypericum_verifier_free(verifier);
+        return ENOMEM;
+    }
+
+    hypericum_pk_internal_t pk = hypericum_pk_parse(verifier->pk);
+    int ret = hypericum_hash_set_keys(verifier->hash_algo, pk.seed, NULL, NULL);
+    if (ret != 0) {
+        hypericum_verifier_free(verifier);
+        return ret;
+    }
+
+    *result = verifier;
+    return 0;
+}
+
+void hypericum_verifier_free(hypericum_verifier_t* verifier)
+{
+    if (NULL == verifier) {
+        return;
+    }
+
+    if (NULL != verifier->hash_algo) {
+        hypericum_hash_clear_keys(verifier->hash_algo);
+        hash_algo_free(verifier->hash_algo);
+    }
+    free(verifier);
+}
+
+int hypericum_verifier_verify(
+    const hypericum_verifier_t* verifier,
+    const uint8_t* sig,
+    const uint8_t* msg,
+    size_t msg_len)
+{
+    return verify_message(
+        verifier->hash_algo, verifier->pk, sig, msg, msg_len, NULL);
+}
+
+
+// Shared state of a batch verification. Tasks get disjoint ranges of items.
+struct verify_batch_job
+{
+    const uint8_t* const* pks;
+    const uint8_t* const* msgs;
+    const size_t* msg_lens;
+    const uint8_t* const* sigs;
+    size_t count;
+    size_t chunk;
+    int* results;
+};
+
+// Verifies the items of range `task` with a hash context of its own. Its key
+// states follow the public key, so runs of items under one key share them.
+// An error is recorded as the result of the items it prevents from being
+// verified, so that every item has a result.
+static int verify_batch_range(void* arg, uint32_t task)
+{
+    const struct verify_batch_job* job = (const struct verify_batch_job*)arg;
+    const size_t first = task * job->chunk;
+    const size_t last =
+        job->count - first < job->chunk ? job->count : first + job->chunk;
+
+    const hash_algo_t hash_algo = hash_algo_new();
+    size_t i = first;
+    int ret = NULL == hash_algo ? ENOMEM : 0;
+    const uint8_t* keyed = NULL;
+    for (; ret == 0 && i < last; i++) {
+        const uint8_t* pk_bytes = job->pks[i];
+
+        if (NULL == keyed ||
+            memcmp(keyed, pk_bytes, HYP_PUBLIC_KEY_BYTES) != 0) {
+            hypericum_pk_internal_t pk = hypericum_pk_parse((uint8_t*)pk_bytes);
+            if ((ret = hypericum_hash_set_keys(
+                     hash_algo, pk.seed, NULL, NULL)) != 0) {
+                break;
+            }
+            keyed = pk_bytes;
+        }
+
+        job->results[i] = verify_message(
+            hash_algo, pk_bytes, job->sigs[i], job->msgs[i], job->msg_lens[i],
+            NULL);
+    }
+    for (; i < last; i++) {
+        job->results[i] = ret;
+    }
+
+    if (NULL != hash_algo) {
+        hypericum_hash_clear_keys(hash_algo);
+        hash_algo_free(hash_algo);
+    }
+    return 0;
+}
+
+int hypericum_verify_batch(
+    const uint8_t* const* pks,
+    const uint8_t* const* msgs,
+    const size_t* msg_lens,
+    const uint8_t* const* sigs,
+    size_t count,
+    int* results)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // a few ranges per thread even out the load between the threads
+    const unsigned threads = hypericum_parallel_threads();
+    size_t tasks = threads > 1 ? 4 * (size_t)threads : 1;
+    if (tasks > count) {
+        tasks = count;
+    }
+
+    struct verify_batch_job job = {
+        .pks = pks,
+        .msgs = msgs,
+        .msg_lens = msg_lens,
+        .sigs = sigs,
+        .count = count,
+        .chunk = (count + tasks - 1) / tasks,
+        .results = results,
+    };
+    hypericum_parallel_for(
+        (uint32_t)((count + job.chunk - 1) / job.chunk), verify_batch_range,
+        &job);
+
+    // an item that failed outweighs the rejected ones
+    int ret = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] != 0 && results[i] < HYPERICUM_REJECT_LENGTH) {
+            return results[i];
+        }
+        ret |= results[i] != 0;
+    }
+    return ret;
+}
+
+
+// A stream is signed in pre-hash mode: the signed message is the label
+// followed by the Streebog-256 hash of the stream.
+#define HYP_PREHASH_LABEL "Hypericum/prehash/Streebog-256"
+#define HYP_PREHASH_LABEL_BYTES (sizeof(HYP_PREHASH_LABEL) - 1)
+#define HYP_PREHASH_BYTES (HYP_PREHASH_LABEL_BYTES + HYPERICUM_N_BYTES)
+
+// Finishes the hash of a stream in `ctx` into the pre-hash message.
+static void prehash_final(
+    const hash_algo_t hash_algo, hash_function_ctx_t ctx, uint8_t* result)
+{
+    memcpy(result, HYP_PREHASH_LABEL, HYP_PREHASH_LABEL_BYTES);
+    hash_algo->ctx_final(ctx, result + HYP_PREHASH_LABEL_BYTES);
+}
+
+struct hypericum_sign_stream_st
+{
+    hash_algo_t hash_algo;
+    hash_function_ctx_t prehash;
+    uint8_t sk[HYP_SECRET_KEY_BYTES];
+};
+
+struct hypericum_verify_stream_st
+{
+    hash_algo_t hash_algo;
+    int prehashed;
+    // hash of the stream in pre-hash mode
+    hash_function_ctx_t prehash;
+    // message digest otherwise
+    hypericum_h_msg_ctx_t h_msg;
+    uint8_t pk[HYP_PUBLIC_KEY_BYTES];
+    uint8_t sig[HYP_SIGNATURE_BYTES];
+};
+
+int hypericum_sign_stream_new(
+    const uint8_t* sk_bytes, hypericum_sign_stream_t** result)
+{
+    hypericum_sign_stream_t* stream =
+        (hypericum_sign_stream_t*)calloc(1, sizeof(hypericum_sign_stream_t));
+    if (NULL == stream) {
+        return ENOMEM;
+    }
+    memcpy(stream->sk, sk_bytes, HYP_SECRET_KEY_BYTES);
+
+    stream->hash_algo = hash_algo_new();
+    if (NULL == stream->hash_algo) {
+        hypericum_sign_stream_free(stream);
+        return ENOMEM;
+    }
+    stream->prehash = stream->hash_algo->ctx_new();
+    if (NULL == stream->prehash) {
+        hypericum_sign_stream_free(stream);
+        return ENOMEM;
+    }
+
+    *result = stream;
+    return 0;
+}
+
+void hypericum_sign_stream_update(
+    hypericum_sign_stream_t* stream, const uint8_t* msg, size_t msg_len)
+{
+    stream->hash_algo->ctx_update(stream->prehash, msg, msg_len);
+}
+
+int hypericum_sign_stream_final(
+    hypericum_sign_stream_t* stream, uint8_t* result_sig)
+{
+    return hypericum_sign_stream_final_timed(stream, result_sig, NULL);
+}
+
+int hypericum_sign_stream_final_timed(
+    hypericum_sign_stream_t* stream,
+    uint8_t* result_sig,
+    hypericum_timings_t* timings)
+{
+    uint8_t prehash[HYP_PREHASH_BYTES];
+    prehash_final(stream->hash_algo, stream->prehash, prehash);
+
+    return sign_message(
+        stream->hash_algo, stream->sk, prehash, HYP_PREHASH_BYTES, NULL, NULL,
+        NULL, timings, result_sig);
+}
+
+void hypericum_sign_stream_free(hypericum_sign_stream_t* stream)
+{
+    if (NULL == stream) {
+        return;
+    }
+
+    if (NULL != stream->prehash) {
+        stream->hash_algo->ctx_free(stream->prehash);
+    }
+    if (NULL != stream->hash_algo) {
+        hash_algo_free(stream->hash_algo);
+    }
+
+    secure_erase(stream->sk, HYP_SECRET_KEY_BYTES);
+    free(stream);
+}
+
+int hypericum_verify_stream_new(
+    const uint8_t* sig_bytes,
+    const uint8_t* pk_bytes,
+    int prehashed,
+    hypericum_verify_stream_t** result)
+{
+    hypericum_verify_stream_t* stream = (hypericum_verify_stream_t*)calloc(
+        1, sizeof(hypericum_verify_stream_t));
+    if (NULL == stream) {
+        return ENOMEM;
+    }
+    stream->prehashed = prehashed;
+    memcpy(stream->pk, pk_bytes, HYP_PUBLIC_KEY_BYTES);
+    memcpy(stream->sig, sig_bytes, HYP_SIGNATURE_BYTES);
+
+    stream->hash_algo = hash_algo_new();
+    if (NULL == stream->hash_algo) {
+        hypericum_verify_stream_free(stream);
+        return ENOMEM;
+    }
+
+    int ret = 0;
+    if (prehashed) {
+        stream->prehash = stream->hash_algo->ctx_new();
+        if (NULL == stream->prehash) {
+            ret = ENOMEM;
+        }
+    } else {
+        hypericum_pk_internal_t pk = hypericum_pk_parse(stream->pk);
+        hypericum_sig_internal_t sig = hypericum_sig_parse(stream->sig);
+        ret = hypericum_h_msg_init(
+            &stream->h_msg, stream->hash_algo, sig.r, pk.seed, pk.root, sig.s);
+    }
+    if (ret != 0) {
+        hypericum_verify_stream_free(stream);
+        return ret;
+    }
+
+    *result = stream;
+    return 0;
+}
+
+void hypericum_verify_stream_update(
+    hypericum_verify_stream_t* stream, const uint8_t* msg, size_t msg_len)
+{
+    if (stream->prehashed) {
+        stream->hash_algo->ctx_update(stream->prehash, msg, msg_len);
+    } else {
+        hypericum_h_msg_update(&stream->h_msg, msg, msg_len);
+    }
+}
+
+int hypericum_verify_stream_final(hypericum_verify_stream_t* stream)
+{
+    return hypericum_verify_stream_final_timed(stream, NULL);
+}
+
+int hypericum_verify_stream_final_timed(
+    hypericum_verify_stream_t* stream, hypericum_timings_t* timings)
+{
+    if (stream->prehashed) {
+        uint8_t prehash[HYP_PREHASH_BYTES];
+        prehash_final(stream->hash_algo, stream->prehash, prehash);
+
+        return verify_message(
+            stream->hash_algo, stream->pk, stream->sig, prehash,
+            HYP_PREHASH_BYTES, timings);
+    }
+
+    uint64_t clock = timings_start(timings);
+    uint8_t digest[64];
+    hypericum_h_msg_final(&stream->h_msg, digest);
+    TIMINGS_LAP(timings, msg_hash_ns, clock);
+
+    return verify_digest(
+        stream->hash_algo, stream->pk, stream->sig, digest, timings);
+}
+
+void hypericum_verify_stream_free(hypericum_verify_stream_t* stream)
+{
+    if (NULL == stream) {
+        return;
+    }
+
+    if (NULL != stream->prehash) {
+        stream->hash_algo->ctx_free(stream->prehash);
+    }
+    if (NULL != stream->h_msg.ctx) {
+        stream->hash_algo->ctx_free(stream->h_msg.ctx);
+    }
+    if (NULL != stream->hash_algo) {
+        hash_algo_free(stream->hash_algo);
+    }
+    free(stream);
+}
@@ -26,6 +26,9 @@
 
 #pragma once
 
+#include "api.h"
+#include "node_cache.h"
+
 #include <stddef.h>
 #include <stdint.h>
 
@@ -34,5 +37,43 @@ int hypericum_generate_keys(uint8_t* pk, uint8_t* sk);
 int hypericum_sign(
     const uint8_t* sk, const uint8_t* m, size_t mlen, uint8_t* sm);
 
+// Same as above, the top layer subtree built during key generation is kept
+// in `cache` and signing takes subtrees from it.
+int hypericum_generate_keys_cached(
+    uint8_t* sk, uint8_t* pk, hypericum_node_cache_t* cache);
+
+int hypericum_sign_cached(
+    const uint8_t* sk,
+    const uint8_t* m,
+    size_t mlen,
+    hypericum_node_cache_t* cache,
+    uint8_t* sm);
+
+// Same as above with an extended secret key of `HYP_SECRET_KEY_EXT_BYTES`
+// made by `hypericum_generate_keys_ext`, whose top layer XMSS tree signing
+// reads instead of rebuilding it. Returns EINVAL if any node of the stored
+// tree is not the one of the public key.
+int hypericum_sign_ext(
+    const uint8_t* sk_ext,
+    const uint8_t* m,
+    size_t mlen,
+    hypericum_node_cache_t* cache,
+    uint8_t* sm);
+
 int hypericum_verify(
     const uint8_t* pk, const uint8_t* sm, const uint8_t* m, size_t mlen);
+
+// Same as above, the durations of the phases go to `timings`.
+int hypericum_sign_timed(
+    const uint8_t* sk,
+    const uint8_t* m,
+    size_t mlen,
+    hypericum_timings_t* timings,
+    uint8_t* sm);
+
+int hypericum_verify_timed(
+    const uint8_t* pk,
+    const uint8_t* sm,
+    const uint8_t* m,
+    size_t mlen,
+    hypericum_timings_t* timings);
@@ -97,6 +97,11 @@ void gost_final(hash_function_ctx_t ctx, uint8_t* out)
     GOST34112012Final((GOST34112012Context*)ctx, out);
 }
 
+void gost_copy(hash_function_ctx_t dst, hash_function_ctx_t src)
+{
+    memcpy(dst, src, sizeof(GOST34112012Context));
+}
+
 hash_algo_t hash_algo_new()
 {
     hash_algo_t hash_ctx = (hash_algo_t)calloc(1, sizeof(struct hash_algo_st));
@@ -112,6 +117,7 @@ hash_algo_t hash_algo_new()
     hash_ctx->ctx_update = gost_update;
     hash_ctx->ctx_final = gost_final;
     hash_ctx->ctx_free = gost_free;
+    hash_ctx->ctx_copy = gost_copy;
 
     return hash_ctx;
 }
@@ -86,6 +86,16 @@ typedef void (*hash_function_final_t)(hash_function_ctx_t ctx, uint8_t* out);
  */
 typedef void (*hash_function_ctx_free_t)(hash_function_ctx_t ctx);
 
+/**
+ * @brief Type definition for hashing context copy function
+ *
+ * @param dst Hashing context created by hash_function_ctx_new_t function,
+ *   receives the state of `src`
+ * @param src Hashing context created by hash_function_ctx_new_t function
+ */
+typedef void (*hash_function_ctx_copy_t)(
+    hash_function_ctx_t dst, hash_function_ctx_t src);
+
 
 /**
  * @brief Structure representing SPHINCS+ hashing algorithm context
@@ -125,8 +135,20 @@ struct hash_algo_st
      */
     hash_function_ctx_free_t ctx_free;
 
+    /**
+     * @brief Function to copy the state of a context, so that hashing may
+     * resume from a state saved after a common prefix.
+     */
+    hash_function_ctx_copy_t ctx_copy;
+
     size_t block_size;   ///< Hashing function block size
     size_t output_size;  ///< Hashing function output size (digest length)
+
+    /**
+     * @brief States precomputed for one key pair, see
+     * `hypericum_hash_set_keys`. NULL if none.
+     */
+    struct hypericum_hash_keys_st* keys;
 };
 
 /**
@@ -139,6 +161,10 @@ typedef struct hash_algo_st* hash_algo_t;
  */
 hash_algo_t hash_algo_new();
 
+/**
+ * @brief Frees the instance, precomputed key states must be dropped before
+ * with `hypericum_hash_clear_keys`.
+ */
 void hash_algo_free(hash_algo_t hash_algo);
 
 /**
@@ -26,6 +26,12 @@
 
 #include "utils.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else  // WIN32
+#include <time.h>
+#endif  // WIN32
+
 void secure_erase(void* buf, size_t len)
 {
 #if (__STDC_VERSION__ >= 201112L) && __STDC_LIB_EXT1__
@@ -38,18 +44,6 @@ void secure_erase(void* buf, size_t len)
 #endif  // (__STDC_VERSION__ >= 201112L) && __STDC_LIB_EXT1__
 }
 
-struct Node* hypericum_create_node(uint32_t h)
-{
-    struct Node* node = (struct Node*)calloc(1, sizeof(struct Node));
-    if (NULL == node) {
-        return NULL;
-    }
-
-    node->h = h;
-
-    return node;
-}
-
 void fill_bytes32(uint8_t* bytes, uint32_t value)
 {
     // big endian
@@ -59,3 +53,18 @@ void fill_bytes32(uint8_t* bytes, uint32_t value)
     bytes[3] = value & 0xFF;
 }
 
+uint64_t hypericum_time_ns()
+{
+#ifdef WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000u +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000u /
+               frequency.QuadPart;
+#else   // WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif  // WIN32
+}
@@ -50,14 +50,22 @@
 
 void secure_erase(void* buf, size_t len);
 
-// data structure and functions for *_tree_hash algoritm
+// Monotonic clock in nanoseconds, times the phases of signing.
+uint64_t hypericum_time_ns();
 
-struct Node
-{
-    uint8_t pk[HYPERICUM_N_BYTES];
-    uint32_t h;
-};
+// data structure for *_tree_hash algoritm
+
+// A treehash over 2^h leaves keeps at most h + 1 nodes on its stack.
+#define HYP_TREEHASH_STACK_NODES \
+    ((HYP_H_PRIME > HYP_B ? HYP_H_PRIME : HYP_B) + 1)
 
-struct Node* hypericum_create_node(uint32_t h);
+// Node values and their heights in parallel arrays, the top of the stack is
+// the entry `size - 1`.
+typedef struct hypericum_treehash_stack_st
+{
+    uint8_t nodes[HYP_TREEHASH_STACK_NODES * HYPERICUM_N_BYTES];
+    uint32_t heights[HYP_TREEHASH_STACK_NODES];
+    uint32_t size;
+} hypericum_treehash_stack_t;
 
 void fill_bytes32(uint8_t* bytes, uint32_t value);
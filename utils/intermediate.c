@@ -5,7 +5,6 @@
 #include "api.h"
 #include "../pack.h"
 
-static uint8_t wots_pk_output_enabled = 1;
 
 void print_hex(const char *label, const uint8_t *data, unsigned long long data_len)
 {
@@ -76,10 +75,7 @@ void print_verify_xmss_pk(const uint8_t *xmss_pk)
 
 void print_verify_wots_pk(const uint8_t *wots_pk)
 {
-    if (wots_pk_output_enabled)
-    {
-        print_hex("WOTS_PK", wots_pk, HYPERICUM_N_BYTES);
-    }
+    print_hex("WOTS_PK", wots_pk, HYPERICUM_N_BYTES);
 }
 
 void print_verify_pk_root(const uint8_t *pk)
@@ -103,13 +99,3 @@ void print_pk(const hypericum_pk_internal_t *pk)
     print_hex("PK.seed", pk->seed, HYPERICUM_N_BYTES);
     print_hex("PK.root", pk->root, HYPERICUM_N_BYTES);
 }
-
-void disable_wots_pk_output()
-{
-    wots_pk_output_enabled = 0;
-}
-
-void enable_wots_pk_output()
-{
-    wots_pk_output_enabled = 1;
-}
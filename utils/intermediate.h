@@ -64,10 +64,6 @@ void print_verify_layer(uint32_t layer);
 
 void print_hex(const char *label, const uint8_t *data, unsigned long long data_len);
 
-void disable_wots_pk_output();
-
-void enable_wots_pk_output();
-
 #endif
 
 
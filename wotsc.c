@@ -237,6 +237,71 @@ int hypericum_sign_wots(
     return ret;
 }
 
+// Completes every chain `i` of `chains` from position `start[i]` up to
+// `HYPERICUM_W - 1` in place. Since the digit sum is fixed the total number
+// of steps is constant, but single chains range from 0 to `HYPERICUM_W - 1`
+// steps. Each lane walks one chain and picks up the next pending chain as soon
+// as its own is finished, so all lanes stay busy until the last chains.
+static void complete_chains(
+    const hash_algo_t hash_algo,
+    const uint8_t *pk_seed,
+    const uint8_t *start,
+    const hypericum_adrs_t *adrs,
+    uint8_t *chains)
+{
+    hypericum_adrs_batch_t lane_adrs;
+    uint8_t *lane_chain[HYPERICUM_HASH_LANES];
+    uint32_t lane_pos[HYPERICUM_HASH_LANES];
+    size_t lanes = 0;
+    size_t next = 0;
+
+    hypericum_adrs_batch_init(&lane_adrs, adrs);
+
+    for (;;)
+    {
+        // refill idle lanes with pending chains
+        while (lanes < HYPERICUM_HASH_LANES && next < HYP_L)
+        {
+            if (start[next] < HYPERICUM_W - 1)
+            {
+                hypericum_adrs_batch_set_wots_hash_chain_address(
+                    &lane_adrs, lanes, next);
+                lane_chain[lanes] = chains + next * HYPERICUM_N_BYTES;
+                lane_pos[lanes] = start[next];
+                ++lanes;
+            }
+            ++next;
+        }
+        if (lanes == 0)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            hypericum_adrs_batch_set_wots_hash_hash_address(
+                &lane_adrs, i, lane_pos[i]);
+        }
+        hypericum_f_lanes(
+            hash_algo, pk_seed, &lane_adrs, (const uint8_t *const *)lane_chain,
+            lane_chain, lanes);
+
+        // retire finished chains, keeping active lanes packed at the front
+        for (size_t i = 0; i < lanes;)
+        {
+            if (++lane_pos[i] < HYPERICUM_W - 1)
+            {
+                ++i;
+                continue;
+            }
+            --lanes;
+            hypericum_adrs_batch_move_lane(&lane_adrs, i, lanes);
+            lane_chain[i] = lane_chain[lanes];
+            lane_pos[i] = lane_pos[lanes];
+        }
+    }
+}
+
 int hypericum_generate_wots_pk_from_sig(
     const hash_algo_t hash_algo,
     const uint8_t *sig,
@@ -274,21 +339,9 @@ int hypericum_generate_wots_pk_from_sig(
     hypericum_adrs_set_type(adrs, address_wots_hash);
     size_t pk_tmp_size = HYP_L * HYPERICUM_N_BYTES;
     ALLOC_ON_STACK(uint8_t, pk_tmp, pk_tmp_size);
-    const uint8_t *sig_iterator = sig;
-    const uint8_t *b_iterator = base_w;
-    uint8_t *pk_iterator = pk_tmp;
-    for (int i = 0; i < HYP_L; ++i, sig_iterator += HYPERICUM_N_BYTES,
-             pk_iterator += HYPERICUM_N_BYTES, ++b_iterator)
-    {
-        hypericum_adrs_set_wots_hash_chain_address(adrs, i);
-        int err_chain = chain(
-            hash_algo, pk_seed, sig_iterator, *b_iterator,
-            HYPERICUM_W - 1 - *b_iterator, adrs, pk_iterator);
-        if (err_chain != 0)
-        {
-            return 1;
-        }
-    }
+    memcpy(pk_tmp, sig, pk_tmp_size);
+
+    complete_chains(hash_algo, pk_seed, base_w, adrs, pk_tmp);
 
     hypericum_adrs_set_type(adrs, address_wots_pk);
     hypericum_thl(hash_algo, pk_seed, adrs, pk_tmp, result_pk);
@@ -28,14 +28,160 @@
 #include "xmss.h"
 #include "wotsc.h"
 #include "hash.h"
+#include "parallel.h"
 #include "utils.h"
 #include "utils/intermediate.h"
 
-#include "stack.h"
-
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 
+// Leaves of one Xmss tree split into ranges of `chunk` leaves.
+struct xmss_leaves_job
+{
+    hash_algo_t hash_algo;
+    const uint8_t* sk_seed;
+    const uint8_t* pk_seed;
+    const hypericum_adrs_t* adrs;
+    uint32_t chunk;
+    uint8_t* leaves;
+};
+
+// Computes the leaves of range `task` with its own address, so that ranges
+// may run on different threads.
+static int xmss_leaves_range(void* arg, uint32_t task)
+{
+    const struct xmss_leaves_job* job = (const struct xmss_leaves_job*)arg;
+
+    hypericum_adrs_t adrs = *job->adrs;
+
+    int ret = 0;
+    for (uint32_t i = task * job->chunk;
+         ret == 0 && i < (task + 1) * job->chunk; i++) {
+        hypericum_adrs_set_keypair_address(&adrs, i);
+        ret = hypericum_generate_wots_pk(
+            job->hash_algo, job->sk_seed, job->pk_seed, &adrs,
+            job->leaves + i * HYPERICUM_N_BYTES);
+    }
+
+    return ret;
+}
+
+int hypericum_xmss_leaves(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    uint8_t* leaves)
+{
+    const uint32_t t = 1u << HYP_H_PRIME;
+    const unsigned threads = hypericum_parallel_threads();
+
+    // a few ranges per thread even out the load between the threads
+    uint32_t tasks = 1;
+    while (threads > 1 && tasks < 4 * threads && tasks < t) {
+        tasks <<= 1;
+    }
+
+    struct xmss_leaves_job job = {
+        .hash_algo = hash_algo,
+        .sk_seed = sk_seed,
+        .pk_seed = pk_seed,
+        .adrs = adrs,
+        .chunk = t / tasks,
+        .leaves = leaves,
+    };
+    return hypericum_parallel_for(tasks, xmss_leaves_range, &job);
+}
+
+
+const uint8_t* hypericum_xmss_subtree_node(
+    const uint8_t* nodes, uint32_t height, uint32_t index)
+{
+    // levels are stored from the leaves up, level `height` starts after
+    // 2^h' + ... + 2^(h' - height + 1) nodes
+    const size_t level = (2u << HYP_H_PRIME) - (2u << (HYP_H_PRIME - height));
+    return nodes + (level + index) * HYPERICUM_N_BYTES;
+}
+
+
+// Computes the nodes above the leaves of a subtree from its leaves.
+static void xmss_subtree_levels(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    uint8_t* nodes)
+{
+    hypericum_adrs_batch_t lane_adrs;
+    const uint8_t* left[HYPERICUM_HASH_LANES];
+    const uint8_t* right[HYPERICUM_HASH_LANES];
+    uint8_t* parent[HYPERICUM_HASH_LANES];
+
+    hypericum_adrs_set_type(adrs, address_tree);
+    hypericum_adrs_batch_init(&lane_adrs, adrs);
+
+    for (uint32_t z = 1; z <= HYP_H_PRIME; z++) {
+        const uint32_t width = 1u << (HYP_H_PRIME - z);
+        const uint8_t* children = hypericum_xmss_subtree_node(nodes, z - 1, 0);
+        uint8_t* level = (uint8_t*)hypericum_xmss_subtree_node(nodes, z, 0);
+
+        for (uint32_t i = 0; i < width; i += HYPERICUM_HASH_LANES) {
+            const size_t lanes = width - i < HYPERICUM_HASH_LANES
+                                     ? width - i
+                                     : HYPERICUM_HASH_LANES;
+            for (size_t l = 0; l < lanes; l++) {
+                hypericum_adrs_batch_set_tree_height(&lane_adrs, l, z);
+                hypericum_adrs_batch_set_tree_index(&lane_adrs, l, i + l);
+                left[l] = children + 2 * (i + l) * HYPERICUM_N_BYTES;
+                right[l] = left[l] + HYPERICUM_N_BYTES;
+                parent[l] = level + (i + l) * HYPERICUM_N_BYTES;
+            }
+            hypericum_h_node_lanes(
+                hash_algo, pk_seed, &lane_adrs, left, right, parent, lanes);
+        }
+    }
+}
+
+int hypericum_xmss_subtree(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    uint8_t* nodes)
+{
+    int ret = 0;
+
+    if ((ret = hypericum_xmss_leaves(
+             hash_algo, sk_seed, pk_seed, adrs, nodes)) != 0) {
+        return ret;
+    }
+    xmss_subtree_levels(hash_algo, pk_seed, adrs, nodes);
+
+    return 0;
+}
+
+int hypericum_xmss_subtree_check(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    const uint8_t* nodes)
+{
+    uint8_t* rebuilt = (uint8_t*)malloc(HYP_XMSS_SUBTREE_BYTES);
+    if (NULL == rebuilt) {
+        return ENOMEM;
+    }
+
+    const size_t leaves_bytes = hypericum_xmss_subtree_node(nodes, 1, 0) - nodes;
+    memcpy(rebuilt, nodes, leaves_bytes);
+    xmss_subtree_levels(hash_algo, pk_seed, adrs, rebuilt);
+
+    int ret = memcmp(rebuilt, nodes, HYP_XMSS_SUBTREE_BYTES) == 0 ? 0 : EINVAL;
+    free(rebuilt);
+    return ret;
+}
+
+
 void hypericum_xmss_tree_hash(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
@@ -45,50 +191,43 @@ void hypericum_xmss_tree_hash(
     hypericum_adrs_t* adrs,
     uint8_t* result)
 {
-    stack_root_t* stack_root_node = NULL;
+    hypericum_treehash_stack_t stack;
+    stack.size = 0;
+
     for (uint32_t i = 0; i < (1u << target_node_h); i++) {
         hypericum_adrs_set_keypair_address(adrs, start_index + i);
 
         uint32_t node_h = 0;
-        struct Node* node = hypericum_create_node(node_h);
+        uint8_t* node = stack.nodes + stack.size * HYPERICUM_N_BYTES;
 
-        hypericum_generate_wots_pk(hash_algo, sk_seed, pk_seed, adrs, node->pk);
+        hypericum_generate_wots_pk(hash_algo, sk_seed, pk_seed, adrs, node);
 
         hypericum_adrs_set_type(adrs, address_tree);
         hypericum_adrs_set_tree_height(adrs, 1);
         hypericum_adrs_set_tree_index(adrs, start_index + i);
 
-        while (!stack_is_empty(stack_root_node) &&
-               ((struct Node*)stack_peek(stack_root_node))->h == node_h) {
+        while (stack.size > 0 && stack.heights[stack.size - 1] == node_h) {
             hypericum_adrs_set_tree_index(
                 adrs, (hypericum_adrs_get_tree_index(adrs) - 1) >> 1);
 
-            struct Node* top_stack_node =
-                (struct Node*)stack_pop(&stack_root_node);
-
-            hypericum_h_node(
-                hash_algo, pk_seed, adrs, top_stack_node->pk, node->pk,
-                node->pk);
-
-            secure_erase(top_stack_node->pk, HYPERICUM_N_BYTES);
-            free(top_stack_node);
+            // the parent replaces the left node on top of the stack
+            uint8_t* top = node - HYPERICUM_N_BYTES;
+            hypericum_h_node(hash_algo, pk_seed, adrs, top, node, top);
+            secure_erase(node, HYPERICUM_N_BYTES);
+            node = top;
+            stack.size--;
 
             node_h = hypericum_adrs_get_tree_height(adrs);
             hypericum_adrs_set_tree_height(adrs, node_h + 1);
         }
-        node->h = node_h;
-        stack_push(&stack_root_node, node);
+        stack.heights[stack.size++] = node_h;
     }
 
-    struct Node* top_node = (struct Node*)stack_peek(stack_root_node);
-    memcpy(result, top_node->pk, HYPERICUM_N_BYTES);
+    memcpy(
+        result, stack.nodes + (stack.size - 1) * HYPERICUM_N_BYTES,
+        HYPERICUM_N_BYTES);
 
-    // clear stack and free all the data if needed
-    while (!stack_is_empty(stack_root_node)) {
-        struct Node* node = (struct Node*)stack_pop(&stack_root_node);
-        secure_erase(node->pk, HYPERICUM_N_BYTES);
-        free(node);
-    }
+    SECURE_ERASE(uint8_t, stack.nodes, sizeof(stack.nodes));
 }
 
 
@@ -109,18 +248,19 @@ void hypericum_xmss_sign(
     const void* sk_seed,
     const void* pk_seed,
     const uint8_t* msg,
+    const uint8_t* nodes,
     uint32_t idx,
     hypericum_adrs_t* adrs,
     uint8_t* result)
 {
-    // build auth path
+    // auth path is the sibling of the path node on every level
     uint8_t* auth = result + HYP_WOTS_BYTES;
 
     for (uint32_t j = 0; j < HYP_H_PRIME; j++) {
-        uint32_t k = ((idx >> j) ^ 1);
-        hypericum_xmss_tree_hash(
-            hash_algo, sk_seed, pk_seed, k * (1u << j), j, adrs,
-            auth + j * HYPERICUM_N_BYTES);
+        memcpy(
+            auth + j * HYPERICUM_N_BYTES,
+            hypericum_xmss_subtree_node(nodes, j, (idx >> j) ^ 1),
+            HYPERICUM_N_BYTES);
     }
     hypericum_adrs_set_type(adrs, address_wots_hash);
     hypericum_adrs_set_keypair_address(adrs, idx);
@@ -128,7 +268,7 @@ void hypericum_xmss_sign(
 }
 
 
-void hypericum_xmss_pk_from_sig(
+int hypericum_xmss_pk_from_sig(
     const hash_algo_t hash_algo,
     const uint8_t* pk_seed,
     const uint8_t* msg,
@@ -140,8 +280,10 @@ void hypericum_xmss_pk_from_sig(
     hypericum_adrs_set_keypair_address(adrs, idx);
 
     uint8_t* auth = (uint8_t*)sig + HYP_WOTS_BYTES;
-    hypericum_generate_wots_pk_from_sig(
-        hash_algo, sig, msg, pk_seed, adrs, result);
+    if (hypericum_generate_wots_pk_from_sig(
+            hash_algo, sig, msg, pk_seed, adrs, result) != 0) {
+        return -1;
+    }
 
     INTERMEDIATE_OUTPUT(print_verify_wots_pk(result));
 
@@ -163,4 +305,5 @@ void hypericum_xmss_pk_from_sig(
                 result);
         }
     }
+    return 0;
 }
@@ -27,10 +27,78 @@
 #pragma once
 
 #include "adrs.h"
+#include "params.h"
 #include "streebog.h"
 
 #include <stdint.h>
 
+// Nodes of a full Xmss subtree, from the leaves up to the root
+#define HYP_XMSS_SUBTREE_NODES ((2u << HYP_H_PRIME) - 1)
+#define HYP_XMSS_SUBTREE_BYTES HYP_TOP_TREE_BYTES
+
+/**
+ * @brief Calculates WOTS+C public keys of all leaves of a Xmss tree. Ranges
+ * of leaves are computed in parallel when `hypericum_set_threads` allows
+ * more than one thread.
+ * @param [in] hypericum Hypericum context
+ * @param [in] sk_seed Sekret key seed with length HYPERICUM_N_BYTES
+ * @param [in] pk_seed Public key seed with length HYPERICUM_N_BYTES
+ * @param [in] adrs Hypericum address
+ * @param [out] leaves Stores `1 << HYP_H_PRIME` leaves with length
+ * HYPERICUM_N_BYTES each
+ * @return 0 on success, error code otherwise
+ */
+int hypericum_xmss_leaves(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    uint8_t* leaves);
+
+/**
+ * @brief Calculates all nodes of a Xmss tree
+ * @param [in] hypericum Hypericum context
+ * @param [in] sk_seed Sekret key seed with length HYPERICUM_N_BYTES
+ * @param [in] pk_seed Public key seed with length HYPERICUM_N_BYTES
+ * @param [in] adrs Hypericum address
+ * @param [out] nodes Stores HYP_XMSS_SUBTREE_BYTES bytes, level by level
+ * starting from the leaves, see `hypericum_xmss_subtree_node`
+ * @return 0 on success, ENOMEM if out of memory
+ */
+int hypericum_xmss_subtree(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    uint8_t* nodes);
+
+/**
+ * @brief Checks that every node of a Xmss tree above the leaves is the hash
+ * of its children. A tree which passes and whose root is known to be right
+ * has the right leaves too.
+ * @param [in] hypericum Hypericum context
+ * @param [in] pk_seed Public key seed with length HYPERICUM_N_BYTES
+ * @param [in] adrs Hypericum address of the tree
+ * @param [in] nodes Nodes of the tree as built by `hypericum_xmss_subtree`
+ * @return 0 if the nodes are consistent, EINVAL if not, ENOMEM if out of
+ * memory
+ */
+int hypericum_xmss_subtree_check(
+    const hash_algo_t hash_algo,
+    const uint8_t* pk_seed,
+    hypericum_adrs_t* adrs,
+    const uint8_t* nodes);
+
+/**
+ * @brief Locates a node in a Xmss tree built by `hypericum_xmss_subtree`
+ * @param [in] nodes Nodes of the tree
+ * @param [in] height Node height, HYP_H_PRIME for the root
+ * @param [in] index Node index among the nodes of the same height
+ * @return node of length HYPERICUM_N_BYTES
+ */
+const uint8_t* hypericum_xmss_subtree_node(
+    const uint8_t* nodes, uint32_t height, uint32_t index);
+
 /**
  * @brief Calculates Xmss tree hash
  * @param [in] hypericum Hypericum context
@@ -71,6 +139,7 @@ void hypericum_xmss_pk(
  * @param [in] sk_seed Sekret key seed with length HYPERICUM_N_BYTES
  * @param [in] pk_seed Public key seed with length HYPERICUM_N_BYTES
  * @param [in] msg Message to sign with length HYPERICUM_N_BYTES
+ * @param [in] nodes Nodes of the xmss tree built by `hypericum_xmss_subtree`
  * @param [in] idx Index of xmss tree
  * @param [in] adrs Hypericum address
  * @param [out] result Stores signature with length wots_bytes (wotsc sign
@@ -81,6 +150,7 @@ void hypericum_xmss_sign(
     const void* sk_seed,
     const void* pk_seed,
     const uint8_t* msg,
+    const uint8_t* nodes,
     uint32_t idx,
     hypericum_adrs_t* adrs,
     uint8_t* result);
@@ -96,8 +166,10 @@ void hypericum_xmss_sign(
  * @param [in] adrs Hypericum address
  * @param [out] result Stores public key calculated from signature with length
  * HYPERICUM_N_BYTES
+ * @return 0 on success, -1 if the WOTS+C digit sum of the signature is wrong,
+ * in which case no public key is computed
  */
-void hypericum_xmss_pk_from_sig(
+int hypericum_xmss_pk_from_sig(
     const hash_algo_t hash_algo,
     const uint8_t* pk_seed,
     const uint8_t* msg,
@@ -26,91 +26,473 @@
 
 #include "xmssmt.h"
 
+#include "hypericum_reject.h"
 #include "xmss.h"
 #include "adrs.h"
+#include "node_cache.h"
+#include "parallel.h"
 #include "utils.h"
 #include "utils/intermediate.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 
 const size_t N = HYPERICUM_N_BYTES;
 
+// Returns nodes of the subtree addressed by `adrs` in `scratch`. They are
+// copied from the cache, or computed and added to the cache on a miss.
+// Returns NULL if out of memory.
+static const uint8_t* subtree_nodes(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    hypericum_node_cache_t* cache,
+    uint32_t layer,
+    uint64_t tree,
+    hypericum_adrs_t* adrs,
+    uint8_t* scratch)
+{
+    if (cache != NULL &&
+        hypericum_node_cache_get(cache, layer, tree, scratch) != NULL) {
+        return scratch;
+    }
+
+    if (hypericum_xmss_subtree(hash_algo, sk_seed, pk_seed, adrs, scratch) !=
+        0) {
+        return NULL;
+    }
+    if (cache != NULL) {
+        hypericum_node_cache_put(cache, layer, tree, scratch);
+    }
+    return scratch;
+}
+
 // 'sk_seed' len: N
 // 'pk_seed' len: N
 // 'result' len: N
-void hypericum_generate_xmssmt_pk(
+int hypericum_generate_xmssmt_pk(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
+    hypericum_node_cache_t* cache,
+    uint8_t* top,
     uint8_t* result)
 {
-    hypericum_adrs_t* adrs = hypericum_adrs_create();
-    hypericum_adrs_set_layer_address(adrs, HYP_D - 1);
-    hypericum_adrs_set_tree_address(adrs, 0);
+    int ret = 0;
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
+    hypericum_adrs_set_layer_address(&adrs, HYP_D - 1);
+    hypericum_adrs_set_tree_address(&adrs, 0);
+
+    uint8_t* scratch = NULL;
+    if (top != NULL) {
+        ret = hypericum_xmss_subtree(hash_algo, sk_seed, pk_seed, &adrs, top);
+        if (ret == 0) {
+            memcpy(result, hypericum_xmss_subtree_node(top, HYP_H_PRIME, 0), N);
+        }
+    } else if (cache == NULL && hypericum_parallel_threads() == 1) {
+        // the root alone doesn't need the whole subtree in memory
+        hypericum_xmss_pk(hash_algo, sk_seed, pk_seed, &adrs, result);
+    } else {
+        // the subtree build is what spreads the leaves over the threads
+        scratch = (uint8_t*)malloc(HYP_XMSS_SUBTREE_BYTES);
+        const uint8_t* nodes =
+            scratch == NULL ? NULL
+                            : subtree_nodes(
+                                  hash_algo, sk_seed, pk_seed, cache,
+                                  HYP_D - 1, 0, &adrs, scratch);
+        if (nodes == NULL) {
+            ret = ENOMEM;
+        } else {
+            memcpy(
+                result, hypericum_xmss_subtree_node(nodes, HYP_H_PRIME, 0), N);
+        }
+    }
+    if (NULL != scratch) {
+        secure_erase(scratch, HYP_XMSS_SUBTREE_BYTES);
+        free(scratch);
+    }
 
-    hypericum_xmss_pk(hash_algo, sk_seed, pk_seed, adrs, result);
+    return ret;
+}
 
-    hypericum_adrs_destroy(adrs);
+// Subtrees of one hypertree signature which are built at once.
+struct xmssmt_build_job
+{
+    hash_algo_t hash_algo;
+    const uint8_t* sk_seed;
+    const uint8_t* pk_seed;
+    const uint64_t* trees;
+    uint32_t layers[HYP_D];
+    uint32_t count;
+    // where each subtree is built
+    uint8_t* nodes[HYP_D];
+};
+
+// Builds the subtree `task` of the job with its own address, so that the
+// subtrees of all layers may be built on different threads.
+static int xmssmt_build_subtree(void* arg, uint32_t task)
+{
+    const struct xmssmt_build_job* job = (const struct xmssmt_build_job*)arg;
+    const uint32_t layer = job->layers[task];
+
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
+    hypericum_adrs_set_layer_address(&adrs, layer);
+    hypericum_adrs_set_tree_address(&adrs, job->trees[layer]);
+
+    int ret = hypericum_xmss_subtree(
+        job->hash_algo, job->sk_seed, job->pk_seed, &adrs, job->nodes[task]);
+
+    return ret;
 }
 
+// Upper layers of the hypertree shared by the signatures of a batch.
+struct hypericum_xmssmt_batch_st
+{
+    // all subtrees of a layer one after the other by tree index, NULL for
+    // the layers built per signature
+    const uint8_t* layers[HYP_D];
+    uint8_t* nodes;
+    size_t nodes_bytes;
+};
+
 // 'sk_seed' len: N
 // 'pk_seed' len: N
 // 'msg' len: N
 // 'result' len: `HYP_XMSSMT_BYTES`
-void hypericum_sign_xmssmt(
+// Subtrees of the layers mapped by `batch` are read from it.
+static int sign_xmssmt(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
     const uint8_t* msg,
     uint64_t idx_tree,
     uint32_t idx_leaf,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    const hypericum_xmssmt_batch_t* batch,
     uint8_t* result)
 {
-    hypericum_adrs_t* adrs = hypericum_adrs_create();
-    hypericum_adrs_set_layer_address(adrs, 0);
-    hypericum_adrs_set_tree_address(adrs, idx_tree);
+    int ret = 0;
+    const int parallel = hypericum_parallel_threads() > 1;
+
+    // addresses of all layers are known before any of them is signed
+    uint64_t trees[HYP_D];
+    uint32_t leaves[HYP_D];
+    for (uint32_t j = 0; j < HYP_D; j++) {
+        trees[j] = idx_tree;
+        leaves[j] = idx_leaf;
+        idx_leaf = idx_tree % (1ull << HYP_H_PRIME);
+        idx_tree = idx_tree >> HYP_H_PRIME;
+    }
 
-    uint8_t* sig_tmp = result;
-    const size_t sig_tmp_len = HYP_XMSSMT_BYTES / HYP_D;
+    const uint8_t* layer_nodes[HYP_D] = { NULL };
+    // the top layer has a single tree
+    layer_nodes[HYP_D - 1] = top;
+    for (uint32_t j = 0; batch != NULL && j < HYP_D; j++) {
+        if (batch->layers[j] != NULL) {
+            layer_nodes[j] =
+                batch->layers[j] + trees[j] * HYP_XMSS_SUBTREE_BYTES;
+        }
+    }
+    struct xmssmt_build_job job = {
+        .hash_algo = hash_algo,
+        .sk_seed = sk_seed,
+        .pk_seed = pk_seed,
+        .trees = trees,
+        .count = 0,
+    };
+
+    // in parallel, every layer not given above has a subtree of `scratch`
+    // to copy its cached nodes to or to be built in
+    uint8_t* scratch = NULL;
+    size_t scratch_bytes = HYP_XMSS_SUBTREE_BYTES;
+    if (parallel) {
+        scratch_bytes = 0;
+        for (uint32_t j = 0; j < HYP_D; j++) {
+            if (layer_nodes[j] == NULL) {
+                scratch_bytes += HYP_XMSS_SUBTREE_BYTES;
+            }
+        }
+    }
 
-    hypericum_xmss_sign(
-        hash_algo, sk_seed, pk_seed, msg, idx_leaf, adrs, sig_tmp);
+    if (scratch_bytes > 0) {
+        scratch = (uint8_t*)malloc(scratch_bytes);
+        if (NULL == scratch) {
+            return ENOMEM;
+        }
+    }
 
-    INTERMEDIATE_OUTPUT(print_sign_ht(0, sig_tmp));
+    if (parallel) {
+        // subtrees missing from the cache are built concurrently, the WOTS+C
+        // signatures chaining the layers are computed afterwards
+        uint8_t* slot = scratch;
+        for (uint32_t j = 0; j < HYP_D; j++) {
+            if (layer_nodes[j] != NULL) {
+                continue;
+            }
+            if (cache != NULL) {
+                layer_nodes[j] =
+                    hypericum_node_cache_get(cache, j, trees[j], slot);
+            }
+            if (layer_nodes[j] == NULL) {
+                job.layers[job.count] = j;
+                job.nodes[job.count++] = slot;
+            }
+            slot += HYP_XMSS_SUBTREE_BYTES;
+        }
 
-    ALLOC_ON_STACK(uint8_t, root, N);
+        ret = hypericum_parallel_for(job.count, xmssmt_build_subtree, &job);
+        for (uint32_t i = 0; i < job.count; i++) {
+            layer_nodes[job.layers[i]] = job.nodes[i];
+            if (ret == 0 && cache != NULL) {
+                hypericum_node_cache_put(
+                    cache, job.layers[i], trees[job.layers[i]], job.nodes[i]);
+            }
+        }
+    }
 
-#ifdef WITH_INTERMEDIATE_OUTPUT
-    disable_wots_pk_output();
-#endif
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
 
-    hypericum_xmss_pk_from_sig(
-        hash_algo, pk_seed, msg, sig_tmp, idx_leaf, adrs, root);
+    uint8_t* sig_tmp = result;
+    const size_t sig_tmp_len = HYP_XMSSMT_BYTES / HYP_D;
 
-    for (uint32_t j = 1; j < HYP_D; j++) {
-        idx_leaf = idx_tree % (1ull << HYP_H_PRIME);
-        idx_tree = idx_tree >> HYP_H_PRIME;
-        hypericum_adrs_set_layer_address(adrs, j);
-        hypericum_adrs_set_tree_address(adrs, idx_tree);
+    // root of the previous layer, signed by the next one
+    ALLOC_ON_STACK(uint8_t, root, N);
 
-        sig_tmp += sig_tmp_len;
+    for (uint32_t j = 0; ret == 0 && j < HYP_D; j++) {
+        hypericum_adrs_set_layer_address(&adrs, j);
+        hypericum_adrs_set_tree_address(&adrs, trees[j]);
+
+        const uint8_t* nodes = layer_nodes[j];
+        if (nodes == NULL) {
+            nodes = subtree_nodes(
+                hash_algo, sk_seed, pk_seed, cache, j, trees[j], &adrs,
+                scratch);
+        }
+        if (nodes == NULL) {
+            ret = ENOMEM;
+            break;
+        }
         hypericum_xmss_sign(
-            hash_algo, sk_seed, pk_seed, root, idx_leaf, adrs, sig_tmp);
+            hash_algo, sk_seed, pk_seed, j == 0 ? msg : root, nodes, leaves[j],
+            &adrs, sig_tmp);
 
         INTERMEDIATE_OUTPUT(print_sign_ht(j, sig_tmp));
 
-        if (j < HYP_D - 1) {
-            hypericum_xmss_pk_from_sig(
-                hash_algo, pk_seed, root, sig_tmp, idx_leaf, adrs, root);
-        }
+        memcpy(root, hypericum_xmss_subtree_node(nodes, HYP_H_PRIME, 0), N);
+        sig_tmp += sig_tmp_len;
     }
     SECURE_ERASE(uint8_t, root, N);
-#ifdef WITH_INTERMEDIATE_OUTPUT
-    enable_wots_pk_output();
-#endif
 
-    hypericum_adrs_destroy(adrs);
+    if (NULL != scratch) {
+        secure_erase(scratch, scratch_bytes);
+        free(scratch);
+    }
+    return ret;
+}
+
+// Bound of the subtrees kept for a batch.
+#define XMSSMT_BATCH_MAX_BYTES ((size_t)256 << 20)
+
+// Subtrees of the layers of a batch which are built up front.
+struct xmssmt_batch_job
+{
+    hash_algo_t hash_algo;
+    const uint8_t* sk_seed;
+    const uint8_t* pk_seed;
+    // lowest mapped layer, the layers above it follow in `nodes`
+    uint32_t first;
+    uint8_t* nodes;
+    // positions in `nodes` of the subtrees to build
+    const uint32_t* missing;
+};
+
+// Number of subtrees of layer `layer`.
+static uint64_t xmssmt_layer_trees(uint32_t layer)
+{
+    return 1ull << (HYP_H - (layer + 1) * HYP_H_PRIME);
+}
+
+// Address of the subtree at position `index` of the layers from `first` on.
+static void xmssmt_batch_address(
+    uint32_t first, uint64_t index, uint32_t* layer, uint64_t* tree)
+{
+    *layer = first;
+    *tree = index;
+    while (*tree >= xmssmt_layer_trees(*layer)) {
+        *tree -= xmssmt_layer_trees(*layer);
+        (*layer)++;
+    }
+}
+
+// Builds the missing subtree `task` of the job.
+static int xmssmt_batch_build(void* arg, uint32_t task)
+{
+    const struct xmssmt_batch_job* job = (const struct xmssmt_batch_job*)arg;
+    const uint32_t index = job->missing[task];
+
+    uint32_t layer = 0;
+    uint64_t tree = 0;
+    xmssmt_batch_address(job->first, index, &layer, &tree);
+
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
+    hypericum_adrs_set_layer_address(&adrs, layer);
+    hypericum_adrs_set_tree_address(&adrs, tree);
+
+    return hypericum_xmss_subtree(
+        job->hash_algo, job->sk_seed, job->pk_seed, &adrs,
+        job->nodes + (size_t)index * HYP_XMSS_SUBTREE_BYTES);
+}
+
+int hypericum_xmssmt_batch_new(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    size_t count,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    hypericum_xmssmt_batch_t** result)
+{
+    hypericum_xmssmt_batch_t* batch =
+        (hypericum_xmssmt_batch_t*)calloc(1, sizeof(hypericum_xmssmt_batch_t));
+    if (NULL == batch) {
+        return ENOMEM;
+    }
+
+    // layers below the top one are kept while all their subtrees together
+    // are no more than one per message, so that building them up front
+    // costs no more than building them per signature; the top layer, a
+    // single subtree, is built only if neither `top` nor the cache holds it
+    const uint32_t last = top != NULL || cache != NULL ? HYP_D - 1 : HYP_D;
+    uint32_t first = last;
+    size_t total = 0;
+    while (first > 0) {
+        const uint32_t height = HYP_H - first * HYP_H_PRIME;
+        if (height >= 32 || total + ((size_t)1 << height) > count ||
+            (total + ((size_t)1 << height)) * HYP_XMSS_SUBTREE_BYTES >
+                XMSSMT_BATCH_MAX_BYTES) {
+            break;
+        }
+        total += (size_t)1 << height;
+        first--;
+    }
+
+    int ret = 0;
+    uint32_t* missing = NULL;
+    if (total > 0) {
+        batch->nodes_bytes = total * HYP_XMSS_SUBTREE_BYTES;
+        batch->nodes = (uint8_t*)malloc(batch->nodes_bytes);
+        missing = (uint32_t*)malloc(total * sizeof(uint32_t));
+        if (NULL == batch->nodes || NULL == missing) {
+            free(missing);
+            hypericum_xmssmt_batch_free(batch);
+            return ENOMEM;
+        }
+
+        size_t offset = 0;
+        for (uint32_t j = first; j < last; j++) {
+            batch->layers[j] = batch->nodes + offset;
+            offset += xmssmt_layer_trees(j) * HYP_XMSS_SUBTREE_BYTES;
+        }
+
+        // subtrees are copied from the cache, only the others are built
+        uint32_t missing_count = 0;
+        for (uint32_t i = 0; i < total; i++) {
+            uint32_t layer = 0;
+            uint64_t tree = 0;
+            xmssmt_batch_address(first, i, &layer, &tree);
+            if (cache == NULL ||
+                hypericum_node_cache_get(
+                    cache, layer, tree,
+                    batch->nodes + (size_t)i * HYP_XMSS_SUBTREE_BYTES) ==
+                    NULL) {
+                missing[missing_count++] = i;
+            }
+        }
+
+        struct xmssmt_batch_job job = {
+            .hash_algo = hash_algo,
+            .sk_seed = sk_seed,
+            .pk_seed = pk_seed,
+            .first = first,
+            .nodes = batch->nodes,
+            .missing = missing,
+        };
+        // a single subtree spreads its leaves over the threads instead
+        ret = missing_count == 1 ? xmssmt_batch_build(&job, 0)
+                                 : hypericum_parallel_for(
+                                       missing_count, xmssmt_batch_build, &job);
+
+        for (uint32_t i = 0; ret == 0 && cache != NULL && i < missing_count;
+             i++) {
+            uint32_t layer = 0;
+            uint64_t tree = 0;
+            xmssmt_batch_address(first, missing[i], &layer, &tree);
+            hypericum_node_cache_put(
+                cache, layer, tree,
+                batch->nodes + (size_t)missing[i] * HYP_XMSS_SUBTREE_BYTES);
+        }
+        free(missing);
+    }
+    if (top != NULL) {
+        batch->layers[HYP_D - 1] = top;
+    }
+
+    if (ret != 0) {
+        hypericum_xmssmt_batch_free(batch);
+        return ret;
+    }
+    *result = batch;
+    return 0;
+}
+
+void hypericum_xmssmt_batch_free(hypericum_xmssmt_batch_t* batch)
+{
+    if (NULL == batch) {
+        return;
+    }
+    if (NULL != batch->nodes) {
+        secure_erase(batch->nodes, batch->nodes_bytes);
+        free(batch->nodes);
+    }
+    free(batch);
+}
+
+int hypericum_sign_xmssmt(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    const uint8_t* msg,
+    uint64_t idx_tree,
+    uint32_t idx_leaf,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    uint8_t* result)
+{
+    return sign_xmssmt(
+        hash_algo, sk_seed, pk_seed, msg, idx_tree, idx_leaf, cache, top, NULL,
+        result);
+}
+
+int hypericum_sign_xmssmt_batch(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    const hypericum_xmssmt_batch_t* batch,
+    const uint8_t* msg,
+    uint64_t idx_tree,
+    uint32_t idx_leaf,
+    hypericum_node_cache_t* cache,
+    uint8_t* result)
+{
+    return sign_xmssmt(
+        hash_algo, sk_seed, pk_seed, msg, idx_tree, idx_leaf, cache, NULL,
+        batch, result);
 }
 
 // 'pk_seed' len: N
@@ -126,17 +508,22 @@ int hypericum_verify_xmssmt(
     uint32_t idx_leaf,
     const uint8_t* pk)
 {
-    hypericum_adrs_t* adrs = hypericum_adrs_create();
+    hypericum_adrs_t adrs;
+    hypericum_adrs_init(&adrs);
 
-    hypericum_adrs_set_layer_address(adrs, 0);
-    hypericum_adrs_set_tree_address(adrs, idx_tree);
+    hypericum_adrs_set_layer_address(&adrs, 0);
+    hypericum_adrs_set_tree_address(&adrs, idx_tree);
 
     uint8_t node[HYPERICUM_N_BYTES] = { 0 };
 
     INTERMEDIATE_OUTPUT(print_verify_layer(0));
 
-    hypericum_xmss_pk_from_sig(
-        hash_algo, pk_seed, msg, sig, idx_leaf, adrs, node);
+    // a wrong digit sum rejects the signature before the layers above
+    if (hypericum_xmss_pk_from_sig(
+            hash_algo, pk_seed, msg, sig, idx_leaf, &adrs, node) != 0) {
+        SECURE_ERASE(uint8_t, node, N);
+        return HYPERICUM_REJECT_WOTS;
+    }
     INTERMEDIATE_OUTPUT(print_verify_xmss_pk(node));
 
     const size_t sig_tmp_len = HYP_XMSSMT_BYTES / HYP_D;
@@ -146,10 +533,14 @@ int hypericum_verify_xmssmt(
         idx_leaf = idx_tree % (1ull << HYP_H_PRIME);
         idx_tree = idx_tree >> HYP_H_PRIME;
         const uint8_t* sig_tmp = sig + j * sig_tmp_len;
-        hypericum_adrs_set_layer_address(adrs, j);
-        hypericum_adrs_set_tree_address(adrs, idx_tree);
-        hypericum_xmss_pk_from_sig(
-            hash_algo, pk_seed, node, sig_tmp, idx_leaf, adrs, node);
+        hypericum_adrs_set_layer_address(&adrs, j);
+        hypericum_adrs_set_tree_address(&adrs, idx_tree);
+        if (hypericum_xmss_pk_from_sig(
+                hash_algo, pk_seed, node, sig_tmp, idx_leaf, &adrs, node) !=
+            0) {
+            SECURE_ERASE(uint8_t, node, N);
+            return HYPERICUM_REJECT_WOTS;
+        }
 
         INTERMEDIATE_OUTPUT(print_verify_xmss_pk(node));
     }
@@ -159,7 +550,5 @@ int hypericum_verify_xmssmt(
     int res = memcmp(node, pk, N);
     SECURE_ERASE(uint8_t, node, N);
 
-    hypericum_adrs_destroy(adrs);
-
-    return res == 0;
+    return res == 0 ? 0 : HYPERICUM_REJECT_ROOT;
 }
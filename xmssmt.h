@@ -26,8 +26,10 @@
 
 #pragma once
 
+#include "node_cache.h"
 #include "streebog.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -36,12 +38,18 @@
  * @param hypericum Hypericum context
  * @param [in] sk_seed Secret key seed of length N
  * @param [in] pk_seed Public key seed of length N
+ * @param [in] cache Optional node cache which receives the top layer subtree
+ * @param [out] top Optional buffer of `HYP_TOP_TREE_BYTES` which receives
+ * the top layer subtree instead of the cache
  * @param [out] result hypertree public key of length N
+ * @param [returns] 0 on success, ENOMEM if out of memory
  */
-void hypericum_generate_xmssmt_pk(
+int hypericum_generate_xmssmt_pk(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
+    hypericum_node_cache_t* cache,
+    uint8_t* top,
     uint8_t* result);
 
 /**
@@ -52,15 +60,79 @@ void hypericum_generate_xmssmt_pk(
  * @param [in] msg Message of length N
  * @param [in] idx_tree hypertree index
  * @param [in] idx_leaf leaf index in a hypertree with index `idx_tree`
+ * @param [in] cache Optional node cache, subtrees are taken from it and
+ * missing ones are added
+ * @param [in] top Optional top layer subtree of `HYP_TOP_TREE_BYTES` stored
+ * at key generation, used instead of building it
  * @param [out] result hypertree signature of length `HYP_XMSSMT_BYTES`
+ * @param [returns] 0 on success, ENOMEM if out of memory
+ *
+ * Every layer subtree is built in full once; the auth path and the root
+ * signed by the next layer are read from it. When `hypericum_set_threads`
+ * allows more than one thread, the subtrees of all layers are built
+ * concurrently before the WOTS+C signatures of the layers are computed.
  */
-void hypericum_sign_xmssmt(
+int hypericum_sign_xmssmt(
     const hash_algo_t hash_algo,
     const uint8_t* sk_seed,
     const uint8_t* pk_seed,
     const uint8_t* msg,
     uint64_t idx_tree,
     uint32_t idx_leaf,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    uint8_t* result);
+
+/* Subtrees of the upper hypertree layers shared by the signatures of a
+ * batch. */
+typedef struct hypericum_xmssmt_batch_st hypericum_xmssmt_batch_t;
+
+/**
+ * @brief Builds the upper layers of the hypertree for a batch of messages.
+ * @param hypericum Hypericum context
+ * @param [in] sk_seed Secret key seed of length N
+ * @param [in] pk_seed Public key seed of length N
+ * @param [in] count number of messages of the batch
+ * @param [in] cache Optional node cache bound to the key
+ * @param [in] top Optional top layer subtree, as for `hypericum_sign_xmssmt`,
+ * which must outlive the batch
+ * @param [out] result new batch, freed by `hypericum_xmssmt_batch_free`
+ * @param [returns] 0 on success, ENOMEM if out of memory
+ *
+ * Every subtree of the layers with no more subtrees than messages in the
+ * batch is copied from the cache, or built once, concurrently when
+ * `hypericum_set_threads` allows more than one thread, and added to the
+ * cache. Signatures of the batch read those layers from it. The top layer is
+ * left to `top` or the cache if given, so a batch of one message costs the
+ * same as a single signature.
+ */
+int hypericum_xmssmt_batch_new(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    size_t count,
+    hypericum_node_cache_t* cache,
+    const uint8_t* top,
+    hypericum_xmssmt_batch_t** result);
+
+void hypericum_xmssmt_batch_free(hypericum_xmssmt_batch_t* batch);
+
+/**
+ * @brief Generate a hypertree signature of a batch message.
+ * @param [in] batch subtrees of the upper layers built for the same seeds
+ *
+ * Same as `hypericum_sign_xmssmt` with the subtrees of the upper layers read
+ * from `batch`. The signature is the same as without a batch.
+ */
+int hypericum_sign_xmssmt_batch(
+    const hash_algo_t hash_algo,
+    const uint8_t* sk_seed,
+    const uint8_t* pk_seed,
+    const hypericum_xmssmt_batch_t* batch,
+    const uint8_t* msg,
+    uint64_t idx_tree,
+    uint32_t idx_leaf,
+    hypericum_node_cache_t* cache,
     uint8_t* result);
 
 
@@ -73,7 +145,8 @@ void hypericum_sign_xmssmt(
  * @param [in] idx_tree hypertree index
  * @param [in] idx_leaf leaf index in a hypertree with index `idx_tree`
  * @param [in] pk hypertree root of length N
- * @param [returns] 1 on success, 0 otherwise
+ * @param [returns] 0 on success, HYPERICUM_REJECT_WOTS as soon as a layer has
+ * a wrong WOTS+C digit sum, HYPERICUM_REJECT_ROOT if the root is not `pk`
  */
 int hypericum_verify_xmssmt(
     const hash_algo_t hash_algo,